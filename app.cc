@@ -16,6 +16,7 @@
 
 #include "app.h"
 
+#include <algorithm>
 #include <climits>
 #include <clocale>
 #include <csignal>
@@ -24,8 +25,11 @@
 #include <cstring>
 
 #include <getopt.h>
+#include <unistd.h>
 
+#include "file.h"
 #include "logger.h"
+#include "memoryscreen.h"
 #include "system.h"
 #include "util.h"
 
@@ -33,14 +37,24 @@ namespace jig {
 namespace {
 
 constexpr int FIG_OPTION = CHAR_MAX + 1;
+constexpr int REPLAY_OPTION = CHAR_MAX + 2;
+
+// The size of the screen a replay is drawn on, unless LINES and COLUMNS say
+// otherwise.
+constexpr int REPLAY_HEIGHT = 24;
+constexpr int REPLAY_WIDTH = 80;
 
 void showUsage(bool err = false) {
   std::fprintf(!err ? stdout : stderr, "Usage: %s FILENAME...\n",
                App::getInstance().getExecName());
   if (!err)
     std::fputs("Options:\n"
-               "  -h, --help     Print this text and exit.\n"
-               "  -v, --version  Print version information and exit.\n",
+               "  -h, --help         Print this text and exit.\n"
+               "  -v, --version      Print version information and exit.\n"
+               "      --replay=KEYS  Run without a terminal, reading the\n"
+               "                     keypresses in the file KEYS. Then print\n"
+               "                     the final screen and how long drawing\n"
+               "                     took.\n",
                stdout);
 }
 
@@ -51,6 +65,59 @@ void showVersion() {
               App::VERSION_BUILD);
 }
 
+// Asked before the UI starts, so it's a plain question on the terminal.
+bool askToRecover(const Document &doc) {
+  if (!isatty(STDIN_FILENO))
+    return false;
+  std::printf("`%s' has changes that were never saved. Recover them? [y/N] ",
+              doc.getFile()->getPath().getCString());
+  std::fflush(stdout);
+  char answer[16];
+  if (!std::fgets(answer, sizeof(answer), stdin))
+    return false;
+  return answer[0] == 'y' || answer[0] == 'Y';
+}
+
+int getReplayDimension(const char *name, int fallback) {
+  const char *value = System::getEnvironmentVariable(name);
+  if (!value)
+    return fallback;
+  int n = std::atoi(value);
+  return n > 0 ? n : fallback;
+}
+
+// Everything in the file at "path" is typed, one byte after another, into a
+// screen that only exists in memory.
+std::unique_ptr<MemoryScreen> createReplayScreen(const char *path) {
+  File file{Path{path}};
+  std::string keys = file.readContents();
+  if (file.hadError())
+    return nullptr;
+  auto screen = std::make_unique<MemoryScreen>(
+    getReplayDimension("LINES", REPLAY_HEIGHT),
+    getReplayDimension("COLUMNS", REPLAY_WIDTH));
+  screen->addInput(keys.data(), keys.size());
+  return screen;
+}
+
+void showReplayResults(const MemoryScreen &screen, unsigned long frames,
+                       long nanos, long maxNanos) {
+  for (int y = 0; y < screen.getHeight(); ++y) {
+    std::string row = screen.getRow(y);
+    row.erase(row.find_last_not_of(' ') + 1);
+    std::printf("%s\n", row.c_str());
+  }
+  std::printf("frames: %lu\n"
+              "mean frame time: %ld us\n"
+              "max frame time: %ld us\n"
+              "cells changed: %llu\n"
+              "bytes emitted: %llu\n",
+              frames, frames > 0 ? nanos / frames / 1000 : 0L,
+              maxNanos / 1000,
+              static_cast<unsigned long long>(screen.getCellsChanged()),
+              static_cast<unsigned long long>(screen.getBytesEmitted()));
+}
+
 void cleanup() {
   App::getInstance().getUI().stop();
   Logger::terminate();
@@ -86,12 +153,17 @@ void cleanupOnSignal(int sig) {
       break;
   }
   Logger::terminate();
-  std::exit(exitStatus);
+  // Running destructors from here could deadlock on a lock held by whatever
+  // was interrupted, and the recovery logs are already on disk as of their
+  // last flush.
+  std::_Exit(exitStatus);
 }
 
 void startup() {
   std::setlocale(LC_ALL, "");
   System::makeDirectory(System::getProgramDirectory());
+  System::makeDirectory(System::getUndoDirectory());
+  System::makeDirectory(System::getRecoveryDirectory());
   Logger::init();
   // std::signal(SIGINT, cleanupOnSignal);
   std::signal(SIGABRT, cleanupOnSignal);
@@ -116,9 +188,11 @@ int App::run(int argc, char **argv) {
   const struct option options[] = {
     {"fig", required_argument, nullptr, FIG_OPTION},
     {"help", no_argument, nullptr, 'h'},
+    {"replay", required_argument, nullptr, REPLAY_OPTION},
     {"version", no_argument, nullptr, 'v'},
     {nullptr, 0, nullptr, 0},
   };
+  const char *replayPath = nullptr;
   int c;
 
   m_ExecName = argv[0];
@@ -132,6 +206,9 @@ int App::run(int argc, char **argv) {
       case FIG_OPTION:
         m_FigManager.init(Path{optarg});
         break;
+      case REPLAY_OPTION:
+        replayPath = optarg;
+        break;
       case 'h':
         showUsage();
         return EXIT_SUCCESS;
@@ -153,13 +230,61 @@ int App::run(int argc, char **argv) {
     for (int i = optind; i < argc; ++i)
       m_DocumentList.addNew(Document::createFromFile(argv[i]));
 
-  m_UI.start();
-  while (m_KeepRunning) {
-    m_UI.draw();
+  for (auto &doc : m_DocumentList) {
+    if (!doc.hasRecoverableChanges())
+      continue;
+    if (askToRecover(doc))
+      doc.recover();
+    else
+      doc.discardRecoverableChanges();
+  }
+
+  // A replay keeps its own pointer to the screen, since the UI owns it.
+  std::unique_ptr<MemoryScreen> replayScreen;
+  const MemoryScreen *replay = nullptr;
+  if (replayPath) {
+    replayScreen = createReplayScreen(replayPath);
+    if (!replayScreen) {
+      std::fprintf(stderr, "%s: failed to read `%s'\n", m_ProgramName,
+                   replayPath);
+      return EXIT_FAILURE;
+    }
+    replay = replayScreen.get();
+  }
+
+  // Each frame is a keypress handled and everything it changed drawn.
+  time::Timer frameTimer;
+  unsigned long frames = 0;
+  long frameNanos = 0L;
+  long maxFrameNanos = 0L;
+
+  // Once a replay runs out of keypresses, it still gets to finish whatever
+  // would've been done while waiting for the next one.
+  auto hasMoreToDo = [this]() {
+    return m_UI.getScreen().hasMoreInput() ||
+           !m_DocumentList.getCurrent().getBuffer()->isIndexed();
+  };
+
+  m_UI.start(std::move(replayScreen));
+  m_UI.draw();
+  while (m_KeepRunning && hasMoreToDo()) {
+    frameTimer.start();
     m_UI.handleInput();
+    m_UI.draw();
+    frameTimer.stop();
+    ++frames;
+    frameNanos += frameTimer.getElapsedNanos();
+    maxFrameNanos = std::max(maxFrameNanos, frameTimer.getElapsedNanos());
+  }
+
+  for (auto &doc : m_DocumentList) {
+    doc.finishSaving();
+    doc.closeRecoveryLog();
   }
 
   cleanup();
+  if (replay)
+    showReplayResults(*replay, frames, frameNanos, maxFrameNanos);
   return EXIT_SUCCESS;
 }
 
@@ -16,147 +16,305 @@
 
 #include "buffer.h"
 
+#include <algorithm>
 #include <assert.h>
-#include <cstdio>
+#include <cstring>
 
+#include "piecetable.h"
+#include "recoverylog.h"
 #include "strutils.h"
 
 namespace jig {
 
+Buffer::Buffer(std::unique_ptr<MappedFile> mapping) {
+  m_Storage = std::make_unique<PieceTable>(std::move(mapping));
+  initLineBuf();
+}
+
+std::uint64_t Buffer::getHash() const {
+  std::uint64_t hash = str::HASH_SEED;
+  for (auto it = getChunks(0, getLength()); it.isValid(); ++it)
+    hash = str::hash((*it).data(), (*it).size(), hash);
+  return hash;
+}
+
+std::uint64_t Buffer::Snapshot::getHash() const {
+  std::uint64_t hash = str::HASH_SEED;
+  for (auto it = getChunks(0, getLength()); it.isValid(); ++it)
+    hash = str::hash((*it).data(), (*it).size(), hash);
+  return hash;
+}
+
 std::string Buffer::getStringAt(std::size_t pos, std::size_t count) const {
-  return m_StrBuf.substr(pos, count);
+  return m_Storage->getStringAt(pos, count);
+}
+
+StringRef Buffer::getStringRefAt(std::size_t pos, std::size_t count,
+                                 std::string &scratch) const {
+  std::size_t len = getLength();
+  assert(pos <= len && "Position is out of bounds");
+  if (count > len - pos)
+    count = len - pos;
+  if (count == 0)
+    return StringRef{};
+
+  Storage::Chunk chunk = getChunkAt(pos);
+  if (pos + count <= chunk.pos + chunk.length)
+    return StringRef{chunk.data + (pos - chunk.pos), count};
+
+  scratch.clear();
+  for (auto it = getChunks(pos, pos + count); it.isValid(); ++it)
+    scratch.append((*it).data(), (*it).size());
+  return StringRef{scratch};
+}
+
+StringRef Buffer::getLineRefAt(std::size_t lineIndex,
+                               std::string &scratch) const {
+  Line line{getLine(lineIndex)};
+  return getStringRefAt(line.begin(), line.size(), scratch);
+}
+
+std::size_t Buffer::find(const std::string &str, std::size_t pos) const {
+  std::size_t len = getLength();
+  if (str.empty())
+    return std::string::npos;
+  for (auto it = getChunks(pos, len); it.isValid(); ++it) {
+    StringRef span = *it;
+    const char *match =
+      std::search(span.begin(), span.end(), str.begin(), str.end());
+    if (match != span.end())
+      return it.getPos() + (match - span.begin());
+
+    // A match that starts near the end of the span could run on into the
+    // next one.
+    std::size_t spanEnd = it.getPos() + span.size();
+    pos = spanEnd - std::min(span.size(), str.size() - 1);
+    for (; pos < spanEnd && pos + str.size() <= len; ++pos) {
+      std::size_t i = 0;
+      while (i < str.size() && getCharAt(pos + i) == str[i])
+        ++i;
+      if (i == str.size())
+        return pos;
+    }
+  }
+  return std::string::npos;
+}
+
+std::size_t Buffer::getTotalLines() const {
+  LineIndex &lines = getLineIndex();
+  lines.indexAll(*m_Storage);
+  return lines.getTotalLines();
+}
+
+bool Buffer::hasLine(std::size_t lineIndex) const {
+  LineIndex &lines = getLineIndex();
+  lines.indexThroughLine(*m_Storage, lineIndex);
+  return lineIndex < lines.getTotalLines();
+}
+
+unsigned int Buffer::getIndexedPercent() const {
+  if (isIndexed())
+    return 100;
+  double frac = static_cast<double>(getLineIndex().getScannedLength()) /
+                static_cast<double>(getLength());
+  return static_cast<unsigned int>(frac * 100.0);
+}
+
+void Buffer::indexMore(std::size_t count) {
+  getLineIndex().indexMore(*m_Storage, count);
 }
 
-std::string Buffer::getLineAt(std::size_t lineIndex) const {
-  assert(lineIndex < m_LineBuf.size() &&
-         "Cannot access line - Index out of bounds");
-  const Line &line{m_LineBuf[lineIndex]};
-  return m_StrBuf.substr(line.begin() - m_StrBuf.begin(), line.size());
+Line Buffer::getLine(std::size_t lineIndex) const {
+  // hasLine() indexes through the Line, so it has to be called even when
+  // assertions are compiled out.
+  bool r = hasLine(lineIndex);
+  assert(r && "Line position is out of bounds");
+  (void)r;
+  return getLineIndex().getLine(lineIndex);
+}
+
+std::size_t Buffer::getLineLength(std::size_t lineIndex) const {
+  bool r = hasLine(lineIndex);
+  assert(r && "Line position is out of bounds");
+  (void)r;
+  return getLineIndex().getLineLength(lineIndex);
 }
 
 std::size_t Buffer::getLineLengthAtPos(std::size_t pos) const {
-  assert(pos < m_StrBuf.size() && "Position is out of bounds");
-  auto SB = m_StrBuf.begin();
-  for (auto I = m_LineBuf.begin(), E = m_LineBuf.end(); I != E; ++I)
-    if (pos >= I->begin() - SB && pos <= I->end() - SB)
-      return I->length();
-  return 0; // This should never be reached.
+  return getLineIndex().getLineLength(getLineIndexAtPos(pos));
 }
 
 std::size_t Buffer::getLineIndexAtPos(std::size_t pos) const {
-  assert(pos < m_StrBuf.size() && "Position is out of bounds");
-  auto SB = m_StrBuf.begin();
-  auto LB = m_LineBuf.begin();
-  for (auto I = LB, E = m_LineBuf.end(); I != E; ++I)
-    if (pos >= I->begin() - SB && pos <= I->end() - SB)
-      return I - LB;
-  return 0; // This should never be reached.
+  assert(pos < getLength() && "Position is out of bounds");
+  LineIndex &lines = getLineIndex();
+  lines.indexThroughPos(*m_Storage, pos);
+  return lines.findLineIndex(pos);
 }
 
-const Line &Buffer::getLineAtPos(std::size_t pos) const {
-  assert(pos < m_StrBuf.size() && "Position is out of bounds");
-  auto SB = m_StrBuf.begin();
-  for (auto I = m_LineBuf.begin(), E = m_LineBuf.end(); I != E; ++I)
-    if (pos >= I->begin() - SB && pos <= I->end() - SB)
-      return *I;
-  return m_LineBuf.back(); // This should never be reached.
+Line Buffer::getLineAtPos(std::size_t pos) const {
+  return getLineIndex().getLine(getLineIndexAtPos(pos));
 }
 
 void Buffer::insert(std::size_t pos, char ch) {
-  m_StrBuf.insert(pos, 1, ch);
-  updateLineBuf();
+  if (m_RecoveryLog)
+    m_RecoveryLog->logInsert(*this, pos, &ch, 1);
+  m_Storage->insert(pos, &ch, 1);
+  updateLines(pos, 0, 1);
+  addChange(pos, 0, 1);
 }
 
 void Buffer::insert(std::size_t pos, const char *str) {
-  m_StrBuf.insert(pos, str);
-  updateLineBuf();
+  insert(pos, str, std::strlen(str));
 }
 
 void Buffer::insert(std::size_t pos, const char *str, std::size_t len) {
-  m_StrBuf.insert(pos, str, len);
-  updateLineBuf();
+  if (m_RecoveryLog)
+    m_RecoveryLog->logInsert(*this, pos, str, len);
+  m_Storage->insert(pos, str, len);
+  updateLines(pos, 0, len);
+  addChange(pos, 0, len);
 }
 
 void Buffer::insert(std::size_t pos, const std::string &str) {
-  m_StrBuf.insert(pos, str);
-  updateLineBuf();
+  insert(pos, str.data(), str.size());
 }
 
 void Buffer::erase(std::size_t pos, std::size_t count /*=1*/) {
-  std::size_t n = m_StrBuf.size() - pos;
+  std::size_t n = getLength() - pos;
   if (n == 1)
     return;
   if (count >= n)
     count = n - 1;
-  m_StrBuf.erase(pos, count);
-  updateLineBuf();
+  if (m_RecoveryLog)
+    m_RecoveryLog->logErase(*this, pos, count);
+  m_Storage->erase(pos, count);
+  updateLines(pos, count, 0);
+  addChange(pos, count, 0);
 }
 
 void Buffer::replace(std::size_t pos, std::size_t count, char ch) {
-  m_StrBuf.erase(pos, count);
-  m_StrBuf.insert(pos, 1, ch);
-  updateLineBuf();
+  replace(pos, count, &ch, 1);
 }
 
 void Buffer::replace(std::size_t pos, std::size_t count, const char *str) {
-  m_StrBuf.erase(pos, count);
-  m_StrBuf.insert(pos, str);
-  updateLineBuf();
+  replace(pos, count, str, std::strlen(str));
 }
 
 void Buffer::replace(std::size_t pos, std::size_t count, const char *str,
                      std::size_t len) {
-  m_StrBuf.erase(pos, count);
-  m_StrBuf.insert(pos, str, len);
-  updateLineBuf();
+  // Like erase(), this keeps the final newline.
+  std::size_t n = getLength() - pos;
+  if (count >= n)
+    count = n - 1;
+  if (m_RecoveryLog) {
+    m_RecoveryLog->logErase(*this, pos, count);
+    m_RecoveryLog->logInsert(*this, pos, str, len);
+  }
+  m_Storage->erase(pos, count);
+  m_Storage->insert(pos, str, len);
+  updateLines(pos, count, len);
+  addChange(pos, count, len);
 }
 
 void Buffer::replace(std::size_t pos, std::size_t count,
                      const std::string &str) {
-  m_StrBuf.erase(pos, count);
-  m_StrBuf.insert(pos, str);
-  updateLineBuf();
+  replace(pos, count, str.data(), str.size());
+}
+
+bool Buffer::mapForward(std::uint64_t version, std::size_t &pos) const {
+  if (version < m_ChangesSince || version > m_Version)
+    return false;
+  for (std::size_t i = version - m_ChangesSince; i < m_Changes.size(); ++i) {
+    const Change &change = m_Changes[i];
+    if (pos >= change.pos + change.erased)
+      pos = pos - change.erased + change.inserted;
+    else if (pos > change.pos)
+      pos = change.pos;
+  }
+  return true;
+}
+
+void Buffer::beginBatch() {
+  ++m_BatchDepth;
+}
+
+void Buffer::endBatch() {
+  assert(m_BatchDepth > 0 && "No batch to end");
+  if (--m_BatchDepth == 0)
+    getLineIndex();
 }
 
-Buffer::LineIterator Buffer::getLineIterator(std::size_t pos) {
-  assert(pos < m_LineBuf.size() && "Line position is out of bounds");
-  return m_LineBuf.begin() + pos;
+// Inside a batch, changes are merged into one pending update instead. It
+// covers everything from the first position any of them touched to the last,
+// which is "m_PendingEnd" in the text as it is now and "m_PendingDelta" bytes
+// less than that in the text the LineIndex was built on.
+void Buffer::updateLines(std::size_t pos, std::size_t erased,
+                         std::size_t inserted) {
+  if (m_BatchDepth == 0) {
+    m_LineIndex.update(*m_Storage, pos, erased, inserted);
+    return;
+  }
+  std::ptrdiff_t delta = static_cast<std::ptrdiff_t>(inserted) -
+                         static_cast<std::ptrdiff_t>(erased);
+  if (!m_LinesPending) {
+    m_LinesPending = true;
+    m_PendingBegin = pos;
+    m_PendingEnd = pos + inserted;
+    m_PendingDelta = delta;
+    return;
+  }
+  m_PendingBegin = std::min(m_PendingBegin, pos);
+  if (pos + erased <= m_PendingEnd)
+    m_PendingEnd += delta;
+  else
+    m_PendingEnd = pos + inserted;
+  m_PendingDelta += delta;
+}
+
+LineIndex &Buffer::getLineIndex() const {
+  if (m_LinesPending) {
+    m_LinesPending = false;
+    std::size_t inserted = m_PendingEnd - m_PendingBegin;
+    std::size_t erased = static_cast<std::size_t>(
+      static_cast<std::ptrdiff_t>(inserted) - m_PendingDelta);
+    m_LineIndex.update(*m_Storage, m_PendingBegin, erased, inserted);
+  }
+  return m_LineIndex;
 }
 
-Buffer::ConstLineIterator Buffer::getConstLineIterator(std::size_t pos) const {
-  assert(pos < m_LineBuf.size() && "Line position is out of bounds");
-  return m_LineBuf.cbegin() + pos;
+void Buffer::initStorage(std::string str, Storage::Type type) {
+  switch (type) {
+    case Storage::Type::PIECE_TABLE:
+      m_Storage = std::make_unique<PieceTable>(std::move(str));
+      break;
+    default:
+      m_Storage = std::make_unique<StringStorage>(std::move(str));
+      break;
+  }
+  initLineBuf();
 }
 
 void Buffer::initLineBuf() {
-  if (m_StrBuf.empty() || m_StrBuf.back() != '\n')
-    m_StrBuf.append(1, '\n');
-  m_LineBuf.reserve(str::occurs(m_StrBuf, '\n'));
-  updateLineBuf();
-}
-
-void Buffer::updateLineBuf() {
-  auto B = m_StrBuf.begin();
-  auto E = m_StrBuf.end();
-  m_LineBuf.clear();
-  for (auto I = B; I != E; ++I) {
-    if (*I == '\n') {
-      if (m_LineBuf.empty()) {
-        m_LineBuf.emplace_back(Line{B, I});
-        continue;
-      }
-      if (I == B || (*(I - 1) == '\n')) {
-        m_LineBuf.emplace_back(Line{I, I});
-        continue;
-      }
-      for (auto P = I - 1; P != B; --P) {
-        if (*P == '\n' || P == B) {
-          m_LineBuf.emplace_back(Line{P == B ? P : P + 1, I});
-          break;
-        }
-      }
-    }
+  std::size_t len = getLength();
+  if (len == 0 || getCharAt(len - 1) != '\n')
+    m_Storage->insert(len, "\n", 1);
+  m_LinesPending = false;
+  m_LineIndex.reset(*m_Storage);
+  ++m_Version;
+
+  // Nothing that came before can be mapped onto the new text.
+  m_Changes.clear();
+  m_ChangesSince = m_Version;
+}
+
+void Buffer::addChange(std::size_t pos, std::size_t erased,
+                       std::size_t inserted) {
+  if (m_Changes.size() == MAX_CHANGES_KEPT) {
+    m_Changes.pop_front();
+    ++m_ChangesSince;
   }
+  m_Changes.push_back(Change{pos, erased, inserted});
+  ++m_Version;
 }
 
 } // namespace jig
@@ -17,44 +17,142 @@
 #ifndef __JIG_BUFFER_H__
 #define __JIG_BUFFER_H__
 
-#include <vector>
+#include <cstdint>
+#include <deque>
+#include <memory>
 
+#include "chunkiterator.h"
 #include "line.h"
+#include "lineindex.h"
+#include "mappedfile.h"
+#include "storage.h"
+#include "stringref.h"
 
 namespace jig {
 
+class RecoveryLog;
+
 class Buffer {
 public:
-  using LineIterator = std::vector<Line>::iterator;
-  using ConstLineIterator = std::vector<Line>::const_iterator;
+  // The text as it was at one version of the Buffer. It can be held and read
+  // by another thread while the Buffer goes on being edited. With a piece
+  // table, taking one is O(1) and shares all of the text. See
+  // Storage::Snapshot.
+  class Snapshot {
+  public:
+    Snapshot(std::unique_ptr<Storage::Snapshot> text, std::uint64_t version)
+        : m_Text{std::move(text)}, m_Version{version} {}
+
+    std::uint64_t getVersion() const { return m_Version; }
+
+    std::size_t getLength() const { return m_Text->getLength(); }
+    Storage::Chunk getChunkAt(std::size_t pos) const {
+      return m_Text->getChunkAt(pos);
+    }
+
+    ChunkIterator<Snapshot> getChunks(std::size_t begin,
+                                      std::size_t end) const {
+      return ChunkIterator<Snapshot>{*this, begin, end};
+    }
+
+    // The str::hash() of the whole text.
+    std::uint64_t getHash() const;
+
+  private:
+    std::unique_ptr<Storage::Snapshot> m_Text;
+    std::uint64_t m_Version;
+  };
+
+  Buffer(const char *str, Storage::Type type = Storage::Type::STRING) {
+    initStorage(str, type);
+  }
+
+  Buffer(std::string str, Storage::Type type = Storage::Type::STRING) {
+    initStorage(std::move(str), type);
+  }
 
-  Buffer(const char *str) : m_StrBuf{str} { initLineBuf(); }
-  Buffer(std::string str) : m_StrBuf{std::move(str)} { initLineBuf(); }
+  // The mapped contents become the original block of a piece table, so they
+  // are never copied onto the heap.
+  Buffer(std::unique_ptr<MappedFile> mapping);
 
   Buffer &operator=(const char *str) {
-    m_StrBuf = str;
-    initLineBuf();
+    initStorage(str, getStorageType());
     return *this;
   }
 
   Buffer &operator=(std::string str) {
-    m_StrBuf = std::move(str);
-    initLineBuf();
+    initStorage(std::move(str), getStorageType());
     return *this;
   }
 
-  const std::string &getStrBuf() const { return m_StrBuf; }
-  const std::vector<Line> &getLineBuf() const { return m_LineBuf; }
+  Storage::Type getStorageType() const { return m_Storage->getType(); }
+
+  // Goes up by one with every change to the text.
+  std::uint64_t getVersion() const { return m_Version; }
+
+  std::unique_ptr<Snapshot> getSnapshot() const {
+    return std::make_unique<Snapshot>(m_Storage->getSnapshot(), m_Version);
+  }
+
+  // Moves "pos", a position in the text as it was at "version", to where the
+  // same place in the text is now. A position inside text that has since
+  // been erased moves to where the erasing happened. Returns false if the
+  // changes made since "version" are no longer known, which is the case once
+  // the text is replaced outright or after MAX_CHANGES_KEPT more changes.
+  bool mapForward(std::uint64_t version, std::size_t &pos) const;
+
+  std::size_t getLength() const { return m_Storage->getLength(); }
+
+  // The str::hash() of the whole text.
+  std::uint64_t getHash() const;
+
+  // Every change to the text is written to "log" before it's made.
+  void setRecoveryLog(RecoveryLog *log) { m_RecoveryLog = log; }
 
-  std::size_t getLength() const { return m_StrBuf.length(); }
-  std::size_t getTotalLines() const { return m_LineBuf.size(); }
+  // Counting every Line means indexing all of them, which can take a while
+  // for a large text. Where only a few Lines are needed, hasLine() only
+  // indexes as far as it has to.
+  std::size_t getTotalLines() const;
+  bool hasLine(std::size_t lineIndex) const;
 
+  // Lines are indexed lazily. These let the rest of the text be indexed a
+  // piece at a time, and report how far along that is.
+  bool isIndexed() const { return getLineIndex().isComplete(); }
+  std::size_t getTotalLinesIndexed() const {
+    return getLineIndex().getTotalLines();
+  }
+  unsigned int getIndexedPercent() const;
+  void indexMore(std::size_t count);
+
+  char getCharAt(std::size_t pos) const { return m_Storage->getCharAt(pos); }
+  Storage::Chunk getChunkAt(std::size_t pos) const {
+    return m_Storage->getChunkAt(pos);
+  }
   std::string getStringAt(std::size_t pos, std::size_t count) const;
-  std::string getLineAt(std::size_t lineIndex) const;
+
+  // Walks the text from "begin" up to "end" a Chunk at a time.
+  ChunkIterator<Storage> getChunks(std::size_t begin, std::size_t end) const {
+    return ChunkIterator<Storage>{*m_Storage, begin, end};
+  }
+
+  // These only copy when the text runs across more than one Chunk, and then
+  // into "scratch", which can be reused from call to call so that it's
+  // rarely allocated. Either way, the result is only good until the next
+  // change to the text or to "scratch".
+  StringRef getStringRefAt(std::size_t pos, std::size_t count,
+                           std::string &scratch) const;
+  StringRef getLineRefAt(std::size_t lineIndex, std::string &scratch) const;
+
+  // Returns where the first occurrence of "str" at or after "pos" begins, or
+  // std::string::npos if there isn't one.
+  std::size_t find(const std::string &str, std::size_t pos) const;
+
+  Line getLine(std::size_t lineIndex) const;
+  std::size_t getLineLength(std::size_t lineIndex) const;
 
   std::size_t getLineLengthAtPos(std::size_t pos) const;
   std::size_t getLineIndexAtPos(std::size_t pos) const;
-  const Line &getLineAtPos(std::size_t pos) const;
+  Line getLineAtPos(std::size_t pos) const;
 
   void insert(std::size_t pos, char ch);
   void insert(std::size_t pos, const char *str);
@@ -69,18 +167,48 @@ public:
                std::size_t len);
   void replace(std::size_t pos, std::size_t count, const std::string &str);
 
-  ConstLineIterator getFirstLineIterator() const { return m_LineBuf.cbegin(); }
-  ConstLineIterator getLastLineIterator() const { return m_LineBuf.cend() - 1; }
-
-  LineIterator getLineIterator(std::size_t pos);
-  ConstLineIterator getConstLineIterator(std::size_t pos) const;
+  // Between these, the Lines aren't re-indexed after every change. All of
+  // the changes are indexed together at the end, or as soon as a Line is
+  // looked up. Batches can be nested.
+  void beginBatch();
+  void endBatch();
 
 private:
+  // How many of the latest changes mapForward() can see past.
+  static constexpr std::size_t MAX_CHANGES_KEPT = 16384;
+
+  struct Change {
+    std::size_t pos;
+    std::size_t erased;
+    std::size_t inserted;
+  };
+
+  void initStorage(std::string str, Storage::Type type);
   void initLineBuf();
-  void updateLineBuf();
 
-  std::string m_StrBuf;
-  std::vector<Line> m_LineBuf;
+  void addChange(std::size_t pos, std::size_t erased, std::size_t inserted);
+
+  void updateLines(std::size_t pos, std::size_t erased, std::size_t inserted);
+  LineIndex &getLineIndex() const;
+
+  std::unique_ptr<Storage> m_Storage = nullptr;
+  std::uint64_t m_Version = 0;
+  RecoveryLog *m_RecoveryLog = nullptr;
+
+  // The latest changes, oldest first. The first one was made to the text as
+  // it was at version "m_ChangesSince".
+  std::deque<Change> m_Changes;
+  std::uint64_t m_ChangesSince = 0;
+
+  // Looking up a Line can index more of the text, even from a const method.
+  mutable LineIndex m_LineIndex;
+
+  // The update a batch has put off, if any. See updateLines().
+  unsigned int m_BatchDepth = 0;
+  mutable bool m_LinesPending = false;
+  std::size_t m_PendingBegin = 0;
+  std::size_t m_PendingEnd = 0;
+  std::ptrdiff_t m_PendingDelta = 0;
 };
 
 } // namespace jig
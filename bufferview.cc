@@ -16,6 +16,7 @@
 
 #include "bufferview.h"
 
+#include <algorithm>
 #include <assert.h>
 
 #include "app.h"
@@ -30,11 +31,15 @@ void BufferView::init() {
 }
 
 void BufferView::updateDimensions() {
-  UI &ui = App::getInstance().getUI();
-  int titleBarHeight = ui.getTitleBar().getHeight();
-  int h = ui.getHeight() - ui.getStatusBar().getHeight() - titleBarHeight;
-  m_Window->resize(h, ui.getWidth());
-  m_Window->move(titleBarHeight, 0);
+  int h;
+  int w;
+  int y;
+  int x;
+  getLayout(h, w, y, x);
+  m_Window->resize(h, w);
+  m_Window->move(y, x);
+  // The Window was made again from scratch, so none of it is left.
+  markRows(0, TO_END);
   writeToWindow();
 }
 
@@ -46,87 +51,237 @@ void BufferView::update() {
 }
 
 void BufferView::initWindow() {
-  App &app = App::getInstance();
-  UI &ui = app.getUI();
-  int titleBarHeight = ui.getTitleBar().getHeight();
-  int h = ui.getHeight() - ui.getStatusBar().getHeight() - titleBarHeight;
-  int w = ui.getWidth();
-  int x = 0;
-
-  if (app.getFig()->get<bool>("ShowLineNumbers")) {
+  int h;
+  int w;
+  int y;
+  int x;
+  getLayout(h, w, y, x);
+  if (x > 0)
     Logger::info("ShowLineNumbers enabled");
-    int lineNumberColumnWidth = ui.getLineNumberColumn()->getWidth();
-    w -= lineNumberColumnWidth;
-    x += lineNumberColumnWidth;
+  View::initWindow("BufferView", h, w, y, x);
+  m_Window->enableKeypad();
+}
+
+// Everything between the TitleBar and the StatusBar, to the right of the
+// LineNumberColumn if there is one.
+void BufferView::getLayout(int &h, int &w, int &y, int &x) const {
+  UI &ui = App::getInstance().getUI();
+  y = ui.getTitleBar().getHeight();
+  h = ui.getHeight() - ui.getStatusBar().getHeight() - y;
+  x = 0;
+  if (ui.getLineNumberColumn())
+    x = ui.getLineNumberColumn()->getWidth();
+  w = ui.getWidth() - x;
+}
+
+void BufferView::damageLines(std::size_t first, std::size_t last) {
+  for (auto it = m_RowCache.begin(); it != m_RowCache.end();) {
+    if (it->first >= first && it->first <= last)
+      it = m_RowCache.erase(it);
+    else
+      ++it;
   }
+  m_ContentDamaged = true;
+  markRows(first, last);
+}
 
-  View::initWindow("BufferView", h, w, titleBarHeight, x);
-  m_Window->enableKeypad();
+void BufferView::markRows(std::size_t first, std::size_t last) {
+  if (!m_Damaged) {
+    m_Damaged = true;
+    m_DamageFirst = first;
+    m_DamageLast = last;
+    return;
+  }
+  m_DamageFirst = std::min(m_DamageFirst, first);
+  m_DamageLast = std::max(m_DamageLast, last);
+}
+
+// Only the rows where the highlighting changes have to be written again:
+// where either end of the selection moved from and to, or everything it
+// covers when it starts or stops.
+void BufferView::damageSelection(bool selecting, std::size_t first,
+                                 std::size_t last) {
+  if (selecting && m_DrawnSelecting) {
+    if (first != m_DrawnSelectionFirst)
+      damagePositions(std::min(first, m_DrawnSelectionFirst),
+                      std::max(first, m_DrawnSelectionFirst));
+    if (last != m_DrawnSelectionLast)
+      damagePositions(std::min(last, m_DrawnSelectionLast),
+                      std::max(last, m_DrawnSelectionLast));
+  } else if (selecting) {
+    damagePositions(first, last);
+  } else if (m_DrawnSelecting) {
+    damagePositions(m_DrawnSelectionFirst, m_DrawnSelectionLast);
+  }
+}
+
+// A selection can outlast the text it covered, so positions past the end
+// are taken to be in the last Line.
+void BufferView::damagePositions(std::size_t begin, std::size_t end) {
+  std::size_t last = m_Buffer->getLength() - 1;
+  markRows(m_Buffer->getLineIndexAtPos(std::min(begin, last)),
+           m_Buffer->getLineIndexAtPos(std::min(end, last)));
 }
 
 void BufferView::writeToWindow() {
   View::writeToWindow();
 
-  auto first = m_Buffer->getConstLineIterator(m_Data->offsetY);
-  auto last = m_Buffer->getLastLineIterator();
-  std::size_t n = last - first;
-  int height = getHeight();
-  int width = getWidth();
+  App &app = App::getInstance();
+  bool selecting = app.getCurrentMode() == App::Mode::SELECT;
+  std::size_t selectionFirst = 0;
+  std::size_t selectionLast = 0;
+  if (selecting) {
+    auto selection = app.getSelectModeHandler().getSelection();
+    selectionFirst = selection.first;
+    selectionLast = selection.second;
+  }
 
-  if (n > height)
-    last -= n - height;
+  if (m_Buffer != m_DrawnBuffer ||
+      (m_Buffer->getVersion() != m_CachedVersion && !m_ContentDamaged))
+    m_RowCache.clear();
+  m_CachedVersion = m_Buffer->getVersion();
+  m_ContentDamaged = false;
 
-  std::size_t p = first->begin() - m_Buffer->getStrBuf().begin();
-  int y = 0;
-  int x;
+  // Everything on screen moves when the view scrolls.
+  if (m_Buffer != m_DrawnBuffer || m_Data->offsetY != m_DrawnOffsetY ||
+      m_Data->offsetX != m_DrawnOffsetX)
+    markRows(0, TO_END);
+  else
+    damageSelection(selecting, selectionFirst, selectionLast);
+  m_DrawnBuffer = m_Buffer;
+  m_DrawnOffsetY = m_Data->offsetY;
+  m_DrawnOffsetX = m_Data->offsetX;
+  m_DrawnSelecting = selecting;
+  m_DrawnSelectionFirst = selectionFirst;
+  m_DrawnSelectionLast = selectionLast;
 
-  auto &app = App::getInstance();
-  App::Mode mode = app.getCurrentMode();
-  auto smh = app.getSelectModeHandler();
-  auto selection = smh.getSelection();
-
-  std::for_each(first, last + 1, [&](const Line &l) {
-    auto len = l.size();
-    if (m_Data->offsetX >= len) {
-      bool selected = (mode == App::Mode::SELECT) &&
-                      smh.isCursorWithinSelection(selection, p);
-      if (selected)
-        m_Window->enableAttrs(Window::Attr::REVERSE);
-      m_Window->put(y, 0, ' ');
-      if (selected)
-        m_Window->disableAttrs(Window::Attr::REVERSE);
-      p += len + 1;
-      ++y;
-      return;
-    }
-    p += m_Data->offsetX;
-    auto b = l.begin() + m_Data->offsetX;
-    auto e = l.end();
-    n = e - b;
-    if (n > width)
-      e -= n - width;
-    x = 0;
-    if (mode == App::Mode::SELECT) {
-      std::for_each(b, e, [&](const char &c) {
-        bool selected = smh.isCursorWithinSelection(selection, p);
-        if (selected)
-          m_Window->enableAttrs(Window::Attr::REVERSE);
-        m_Window->put(y, x++, c);
-        if (selected)
-          m_Window->disableAttrs(Window::Attr::REVERSE);
-        ++p;
-      });
-    } else {
-      std::for_each(b, e, [&](const char &c) {
-        m_Window->put(y, x++, c);
-        ++p;
-      });
+  if (m_Damaged) {
+    m_Damaged = false;
+    std::size_t first = m_Data->offsetY;
+    int height = getHeight();
+    for (int y = 0; y < height; ++y) {
+      std::size_t i = first + y;
+      if (i >= m_DamageFirst && i <= m_DamageLast)
+        writeRow(y, i);
     }
-    ++p;
-    ++y;
-  });
+    trimRowCache();
+  }
 
   m_Window->moveCursor(m_Data->cursorY, m_Data->cursorX);
 }
 
+// Returns nullptr if there is no such Line.
+const BufferView::CachedRow *BufferView::getRow(std::size_t lineIndex) {
+  std::size_t width = getWidth();
+  auto it = m_RowCache.find(lineIndex);
+  if (it != m_RowCache.end() && it->second.offsetX == m_Data->offsetX &&
+      it->second.width == width) {
+    ++m_RowCacheHits;
+    return &it->second;
+  }
+  ++m_RowCacheMisses;
+
+  // Only the Lines that are actually shown need to have been indexed.
+  if (!m_Buffer->hasLine(lineIndex))
+    return nullptr;
+
+  CachedRow &row = m_RowCache[lineIndex];
+  row.offsetX = m_Data->offsetX;
+  row.width = width;
+  row.text.clear();
+
+  Line line{m_Buffer->getLine(lineIndex)};
+  std::size_t len = line.size();
+  if (m_Data->offsetX >= len)
+    return &row;
+  std::size_t p = line.begin() + m_Data->offsetX;
+  std::size_t n = std::min(len - m_Data->offsetX, width);
+  // A row can run across several Chunks of the Buffer.
+  for (auto chunk = m_Buffer->getChunks(p, p + n); chunk.isValid(); ++chunk)
+    row.text.append((*chunk).data(), (*chunk).size());
+  return &row;
+}
+
+// Drops the rows furthest from the ones on screen once there are too many.
+void BufferView::trimRowCache() {
+  std::size_t height = getHeight();
+  if (m_RowCache.size() <= ROW_CACHE_SCREENS * height)
+    return;
+  std::size_t first = m_Data->offsetY;
+  std::size_t keepFirst = first > height ? first - height : 0;
+  std::size_t keepLast = first + 2 * height;
+  for (auto it = m_RowCache.begin(); it != m_RowCache.end();) {
+    if (it->first < keepFirst || it->first > keepLast)
+      it = m_RowCache.erase(it);
+    else
+      ++it;
+  }
+}
+
+void BufferView::writeRow(int y, std::size_t lineIndex) {
+  const CachedRow *row = getRow(lineIndex);
+  if (!row) {
+    m_Window->clearToEndOfLine(y, 0);
+    return;
+  }
+
+  // The selected part of the row, from selectionBegin up to selectionEnd,
+  // is worked out once rather than once per character.
+  std::size_t selectionBegin = 0;
+  std::size_t selectionEnd = 0;
+  std::size_t p = 0;
+  if (m_DrawnSelecting) {
+    selectionBegin = m_DrawnSelectionFirst;
+    selectionEnd = m_DrawnSelectionLast + 1;
+    p = m_Buffer->getLine(lineIndex).begin();
+    if (!row->text.empty())
+      p += m_Data->offsetX;
+  }
+
+  if (row->text.empty()) {
+    bool selected = p >= selectionBegin && p < selectionEnd;
+    if (selected)
+      m_Window->enableAttrs(Window::Attr::REVERSE);
+    m_Window->put(y, 0, ' ');
+    if (selected)
+      m_Window->disableAttrs(Window::Attr::REVERSE);
+    m_Window->clearToEndOfLine(y, 1);
+    return;
+  }
+
+  // A selection splits the row into at most three spans: before it, in it
+  // and after it.
+  const std::string &text = row->text;
+  std::size_t end = p + text.size();
+  std::size_t a = std::min(std::max(selectionBegin, p), end) - p;
+  std::size_t b = std::min(std::max(selectionEnd, p), end) - p;
+  writeSpan(y, 0, text.data(), a);
+  if (b > a) {
+    m_Window->enableAttrs(Window::Attr::REVERSE);
+    writeSpan(y, a, text.data() + a, b - a);
+    m_Window->disableAttrs(Window::Attr::REVERSE);
+  }
+  writeSpan(y, b, text.data() + b, text.size() - b);
+  if (text.size() < row->width)
+    m_Window->clearToEndOfLine(y, text.size());
+}
+
+// Anything that isn't printable ASCII is written on its own, the way every
+// character used to be. ncurses can draw it more than one column wide, but
+// the next character still goes in the very next column.
+void BufferView::writeSpan(int y, int x, const char *str, std::size_t count) {
+  std::size_t begin = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    unsigned char c = static_cast<unsigned char>(str[i]);
+    if (c >= 0x20 && c < 0x7f)
+      continue;
+    if (i > begin)
+      m_Window->put(y, x + begin, str + begin, i - begin);
+    m_Window->put(y, x + i, str[i]);
+    begin = i + 1;
+  }
+  if (count > begin)
+    m_Window->put(y, x + begin, str + begin, count - begin);
+}
+
 } // namespace jig
@@ -17,6 +17,10 @@
 #ifndef __JIG_BUFFERVIEW_H__
 #define __JIG_BUFFERVIEW_H__
 
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
 #include "buffer.h"
 #include "view.h"
 
@@ -33,19 +37,82 @@ public:
     int cursorX = 0;
   };
 
+  // Passed as the last Line to damageLines() when every Line from the first
+  // one onwards has to be written again.
+  static constexpr std::size_t TO_END = std::string::npos;
+
   BufferView() = default;
 
   virtual void init() final;
   virtual void updateDimensions() final;
 
+  // Only the rows that show a damaged Line are written by the next update(),
+  // so that a keystroke doesn't rewrite the whole screen. Everything is
+  // written again when the view scrolls or shows another Buffer, without
+  // having to be told. The rows a selection's highlighting changes on are
+  // found the same way.
+  void damageLines(std::size_t first, std::size_t last);
+  void damageAll() { damageLines(0, TO_END); }
+
   void update();
 
+  // How often a row that had to be written could be taken from the row
+  // cache rather than read from the Buffer.
+  std::uint64_t getRowCacheHits() const { return m_RowCacheHits; }
+  std::uint64_t getRowCacheMisses() const { return m_RowCacheMisses; }
+
 private:
+  // The part of a Line that was last shown, for a given offsetX and width.
+  // Where it is in the Buffer isn't kept, since an edit to an earlier Line
+  // moves it without changing it.
+  struct CachedRow {
+    std::size_t offsetX;
+    std::size_t width;
+    std::string text;
+  };
+
+  // The cache holds at most this many screens' worth of rows.
+  static constexpr std::size_t ROW_CACHE_SCREENS = 4;
+
   void initWindow();
+  void getLayout(int &h, int &w, int &y, int &x) const;
   void writeToWindow();
+  void markRows(std::size_t first, std::size_t last);
+  void damageSelection(bool selecting, std::size_t first, std::size_t last);
+  void damagePositions(std::size_t begin, std::size_t end);
+
+  const CachedRow *getRow(std::size_t lineIndex);
+  void trimRowCache();
+
+  void writeRow(int y, std::size_t lineIndex);
+  void writeSpan(int y, int x, const char *str, std::size_t count);
 
   const Buffer *m_Buffer = nullptr;
   const Data *m_Data = nullptr;
+
+  // The Lines that have to be written again, from m_DamageFirst up to and
+  // including m_DamageLast.
+  bool m_Damaged = true;
+  std::size_t m_DamageFirst = 0;
+  std::size_t m_DamageLast = TO_END;
+
+  // What the rows that are on screen were written for.
+  const Buffer *m_DrawnBuffer = nullptr;
+  std::size_t m_DrawnOffsetY = 0;
+  std::size_t m_DrawnOffsetX = 0;
+  bool m_DrawnSelecting = false;
+  std::size_t m_DrawnSelectionFirst = 0;
+  std::size_t m_DrawnSelectionLast = 0;
+
+  // Rows that have been read from the Buffer, by Line index, so that
+  // scrolling over them again doesn't have to. A damaged Line is dropped.
+  // So is everything, should the Buffer's version change without any damage
+  // being reported.
+  std::unordered_map<std::size_t, CachedRow> m_RowCache;
+  std::uint64_t m_CachedVersion = 0;
+  bool m_ContentDamaged = false;
+  std::uint64_t m_RowCacheHits = 0;
+  std::uint64_t m_RowCacheMisses = 0;
 };
 
 } // namespace jig
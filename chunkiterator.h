@@ -0,0 +1,86 @@
+//===--- chunkiterator.h ------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_CHUNKITERATOR_H__
+#define __JIG_CHUNKITERATOR_H__
+
+#include <algorithm>
+#include <cstddef>
+
+#include "storage.h"
+#include "stringref.h"
+
+namespace jig {
+
+// Walks the Chunks of the text from "begin" up to "end", in either direction,
+// as contiguous spans that are cut to fit inside that range. "Source" is a
+// Storage or a Storage::Snapshot, and has to outlive the iterator. Nothing
+// about the Storage is assumed beyond getChunkAt(), so the text never has to
+// be flattened into one string to be read from start to finish.
+template <typename Source>
+class ChunkIterator {
+public:
+  ChunkIterator(const Source &source, std::size_t begin, std::size_t end)
+      : m_Source{&source}, m_Begin{begin},
+        m_End{std::min(end, source.getLength())} {
+    first();
+  }
+
+  bool isValid() const { return m_Valid; }
+
+  // Where the current span begins in the text.
+  std::size_t getPos() const { return std::max(m_Chunk.pos, m_Begin); }
+
+  StringRef operator*() const {
+    std::size_t pos = getPos();
+    std::size_t stop = std::min(m_Chunk.pos + m_Chunk.length, m_End);
+    return StringRef{m_Chunk.data + (pos - m_Chunk.pos), stop - pos};
+  }
+
+  void first() { load(m_Begin); }
+  void last() { load(m_End == 0 ? m_End : m_End - 1); }
+
+  void next() { load(m_Chunk.pos + m_Chunk.length); }
+  void prev() { load(m_Chunk.pos <= m_Begin ? m_End : m_Chunk.pos - 1); }
+
+  ChunkIterator &operator++() {
+    next();
+    return *this;
+  }
+
+  ChunkIterator &operator--() {
+    prev();
+    return *this;
+  }
+
+private:
+  // Anywhere outside the range leaves the iterator invalid.
+  void load(std::size_t pos) {
+    m_Valid = pos >= m_Begin && pos < m_End;
+    if (m_Valid)
+      m_Chunk = m_Source->getChunkAt(pos);
+  }
+
+  const Source *m_Source;
+  std::size_t m_Begin;
+  std::size_t m_End;
+  Storage::Chunk m_Chunk{nullptr, 0, 0};
+  bool m_Valid = false;
+};
+
+} // namespace jig
+
+#endif // __JIG_CHUNKITERATOR_H__
@@ -16,13 +16,24 @@
 
 #include "document.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 
 #include "app.h"
 #include "logger.h"
 
 namespace jig {
 
+Document::Document() {
+  const Fig *fig = App::getInstance().getFig();
+  int undoLimit = fig->get<int>("UndoMemoryLimitMiB");
+  if (undoLimit > 0)
+    m_EditHistory.setMemoryLimit(static_cast<std::size_t>(undoLimit) * 1024 *
+                                 1024);
+  m_PersistentUndo = fig->get<bool>("PersistentUndo");
+}
+
 Document Document::createEmpty(const std::string &title) {
   Document doc;
   doc.setTitle(title);
@@ -42,51 +53,50 @@ Document Document::createFromFile(const std::string &path) {
   Document doc;
   doc.setContentsFromFile(path);
   doc.setTitle(doc.getFile()->getPath().getBasename());
+  if (doc.m_PersistentUndo && doc.m_File->exists())
+    doc.m_EditHistory.loadJournal(doc.m_File->getPath(), *doc.m_Buffer);
+
+  int flushMillis =
+    App::getInstance().getFig()->get<int>("RecoveryLogFlushMillis");
+  if (flushMillis > 0) {
+    doc.m_RecoveryLog =
+      std::make_unique<RecoveryLog>(doc.m_File->getPath(), flushMillis);
+    doc.m_RecoveryLog->readOld(*doc.m_Buffer, doc.m_RecoverableChanges,
+                               doc.m_RecoverableText);
+    doc.m_Buffer->setRecoveryLog(doc.m_RecoveryLog.get());
+  }
   return doc;
 }
 
 Document &Document::insert(char ch) {
-  std::unique_ptr<Edit> edit =
-    std::make_unique<InsertEdit>(getCursorPosition(), ch);
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
+  std::size_t pos = getCursorPosition();
+  markChanged(pos, 0, &ch, 1);
+  m_EditHistory.insert(*m_Buffer, pos, &ch, 1);
   if (ch == '\n') {
     moveCursorDown();
     moveCursorToBeginningOfLine();
   } else {
     moveCursorRight();
   }
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
   return *this;
 }
 
 Document &Document::insert(const std::string &str) {
-  std::unique_ptr<Edit> edit =
-    std::make_unique<InsertEdit>(getCursorPosition(), str);
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  std::size_t pos = getCursorPosition();
+  markChanged(pos, 0, str.data(), str.size());
+  m_EditHistory.insert(*m_Buffer, pos, str.data(), str.size());
   return *this;
 }
 
 Document &Document::insert(std::size_t pos, char ch) {
-  std::unique_ptr<Edit> edit = std::make_unique<InsertEdit>(pos, ch);
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  markChanged(pos, 0, &ch, 1);
+  m_EditHistory.insert(*m_Buffer, pos, &ch, 1);
   return *this;
 }
 
 Document &Document::insert(std::size_t pos, std::string &&str) {
-  std::unique_ptr<Edit> edit =
-    std::make_unique<InsertEdit>(pos, std::move(str));
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  markChanged(pos, 0, str.data(), str.size());
+  m_EditHistory.insert(*m_Buffer, pos, str.data(), str.size());
   return *this;
 }
 
@@ -95,66 +105,46 @@ Document &Document::eraseBack(std::size_t count) {
   if (pos == 0)
     return *this;
 
-  if (m_Buffer->getStrBuf()[pos - 1] == '\n') {
+  if (count <= pos)
+    markChanged(pos - count, count, nullptr, 0);
+  if (m_Buffer->getCharAt(pos - 1) == '\n') {
     moveCursorUp();
     moveCursorToEndOfLine();
   } else {
     moveCursorLeft();
   }
 
-  std::unique_ptr<Edit> edit = std::make_unique<EraseBackEdit>(pos, count);
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  m_EditHistory.eraseBack(*m_Buffer, pos, count);
   return *this;
 }
 
 Document &Document::eraseBack(std::size_t pos, std::size_t count) {
-  std::unique_ptr<Edit> edit = std::make_unique<EraseBackEdit>(pos, count);
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  if (count <= pos)
+    markChanged(pos - count, count, nullptr, 0);
+  m_EditHistory.eraseBack(*m_Buffer, pos, count);
   return *this;
 }
 
 Document &Document::eraseFront(std::size_t count) {
-  std::unique_ptr<Edit> edit =
-    std::make_unique<EraseFrontEdit>(getCursorPosition(), count);
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
-  return *this;
+  return eraseFront(getCursorPosition(), count);
 }
 
 Document &Document::eraseFront(std::size_t pos, std::size_t count) {
-  std::unique_ptr<Edit> edit = std::make_unique<EraseFrontEdit>(pos, count);
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  markChanged(pos, count, nullptr, 0);
+  m_EditHistory.eraseFront(*m_Buffer, pos, count);
   return *this;
 }
 
 Document &Document::replace(std::size_t pos, std::size_t count, char ch) {
-  std::unique_ptr<Edit> edit = std::make_unique<ReplaceEdit>(pos, count, ch);
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  markChanged(pos, count, &ch, 1);
+  m_EditHistory.replace(*m_Buffer, pos, count, &ch, 1);
   return *this;
 }
 
 Document &Document::replace(std::size_t pos, std::size_t count,
                             std::string &&str) {
-  std::unique_ptr<Edit> edit =
-    std::make_unique<ReplaceEdit>(pos, count, std::move(str));
-  edit->apply(*m_Buffer);
-  m_EditHistory.addNew(std::move(edit));
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  markChanged(pos, count, str.data(), str.size());
+  m_EditHistory.replace(*m_Buffer, pos, count, str.data(), str.size());
   return *this;
 }
 
@@ -162,8 +152,7 @@ Document &Document::undo() {
   if (!canUndo())
     return *this;
   m_EditHistory.undo(*m_Buffer);
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  markChanged();
   return *this;
 }
 
@@ -171,11 +160,69 @@ Document &Document::redo() {
   if (!canRedo())
     return *this;
   m_EditHistory.redo(*m_Buffer);
-  App::getInstance().getUI().getBufferView().clear();
-  m_Dirty = true;
+  markChanged();
   return *this;
 }
 
+Document &Document::goBackInTime() {
+  std::int64_t step = TIME_TRAVEL_STEP_SECS * time::Timer::NANOS_PER_SEC;
+  std::size_t current = m_EditHistory.getCurrent();
+  m_EditHistory.goToTime(*m_Buffer, m_EditHistory.getCurrentTime() - step);
+  if (m_EditHistory.getCurrent() != current)
+    markChanged();
+  return *this;
+}
+
+Document &Document::goForwardInTime() {
+  std::int64_t step = TIME_TRAVEL_STEP_SECS * time::Timer::NANOS_PER_SEC;
+  std::size_t current = m_EditHistory.getCurrent();
+  m_EditHistory.goToTime(*m_Buffer, m_EditHistory.getCurrentTime() + step);
+  if (m_EditHistory.getCurrent() != current)
+    markChanged();
+  return *this;
+}
+
+void Document::beginBatch() {
+  m_Buffer->beginBatch();
+  m_EditHistory.beginBatch();
+  m_Batching = true;
+}
+
+void Document::commitBatch() {
+  m_EditHistory.endBatch();
+  m_Buffer->endBatch();
+  m_Batching = false;
+  if (m_BatchChanged)
+    App::getInstance().getUI().getBufferView().damageAll();
+  m_BatchChanged = false;
+}
+
+std::size_t Document::replaceAll(const std::string &from,
+                                 const std::string &to) {
+  // Every match is found before any are replaced, so that a replacement can't
+  // be matched itself. They're replaced last to first, so that each one is
+  // still where it was found.
+  std::vector<std::size_t> matches;
+  for (std::size_t pos = m_Buffer->find(from, 0); pos != std::string::npos;
+       pos = m_Buffer->find(from, pos + from.size()))
+    matches.push_back(pos);
+  if (matches.empty())
+    return 0;
+
+  // The cursor stays on the same text, as long as that wasn't replaced.
+  std::size_t cursor = getCursorPosition();
+  std::uint64_t version = m_Buffer->getVersion();
+  beginBatch();
+  for (auto it = matches.rbegin(); it != matches.rend(); ++it)
+    m_EditHistory.replace(*m_Buffer, *it, from.size(), to.data(), to.size());
+  markChanged();
+  commitBatch();
+  if (!m_Buffer->mapForward(version, cursor))
+    cursor = std::min(cursor, m_Buffer->getLength() - 1);
+  moveCursorTo(cursor);
+  return matches.size();
+}
+
 void Document::moveCursorLeft() {
   auto &app = App::getInstance();
 
@@ -183,7 +230,6 @@ void Document::moveCursorLeft() {
     if (m_ViewData.offsetX == 0)
       return;
     --m_ViewData.offsetX;
-    app.getUI().getBufferView().clear();
     goto finish;
   }
 
@@ -201,16 +247,13 @@ void Document::moveCursorLeft(int n) {
 }
 
 void Document::moveCursorRight() {
-  auto line = m_Buffer->getConstLineIterator(m_ViewData.lineIndex);
-
-  if (m_ViewData.pos < line->length()) {
+  if (m_ViewData.pos < m_Buffer->getLineLength(m_ViewData.lineIndex)) {
     auto &app = App::getInstance();
     auto &view = app.getUI().getBufferView();
     if (m_ViewData.cursorX < view.getWidth() - 1) {
       ++m_ViewData.cursorX;
     } else {
       ++m_ViewData.offsetX;
-      view.clear();
     }
     ++m_ViewData.pos;
     if (app.getCurrentMode() == App::Mode::SELECT)
@@ -224,13 +267,10 @@ void Document::moveCursorRight(int n) {
 }
 
 void Document::moveCursorUp() {
-  auto line = m_Buffer->getConstLineIterator(m_ViewData.lineIndex);
-
-  if (line == m_Buffer->getFirstLineIterator())
+  if (m_ViewData.lineIndex == 0)
     return;
 
-  --line;
-  --m_ViewData.lineIndex;
+  std::size_t length = m_Buffer->getLineLength(--m_ViewData.lineIndex);
 
   auto &app = App::getInstance();
   App::Mode mode = app.getCurrentMode();
@@ -238,18 +278,17 @@ void Document::moveCursorUp() {
   if (mode == App::Mode::SELECT)
     app.getSelectModeHandler().moveLeft(m_ViewData.pos);
 
-  if (line->length() < m_ViewData.pos) {
-    m_ViewData.pos = line->length();
+  if (length < m_ViewData.pos) {
+    m_ViewData.pos = length;
     m_ViewData.cursorX = m_ViewData.pos;
   } else if (mode == App::Mode::SELECT) {
-    app.getSelectModeHandler().moveLeft(line->length() - m_ViewData.pos + 1);
+    app.getSelectModeHandler().moveLeft(length - m_ViewData.pos + 1);
   }
 
   if (m_ViewData.cursorY > 0) {
     --m_ViewData.cursorY;
   } else if (m_ViewData.offsetY > 0) {
     --m_ViewData.offsetY;
-    app.getUI().getBufferView().clear();
   }
 }
 
@@ -259,23 +298,21 @@ void Document::moveCursorUp(int n) {
 }
 
 void Document::moveCursorDown() {
-  auto line = m_Buffer->getConstLineIterator(m_ViewData.lineIndex);
-
-  if (line == m_Buffer->getLastLineIterator())
+  if (!m_Buffer->hasLine(m_ViewData.lineIndex + 1))
     return;
 
+  std::size_t length = m_Buffer->getLineLength(m_ViewData.lineIndex);
+
   auto &app = App::getInstance();
   App::Mode mode = app.getCurrentMode();
 
   if (mode == App::Mode::SELECT)
-    app.getSelectModeHandler().moveRight(*this,
-                                         line->length() - m_ViewData.pos);
+    app.getSelectModeHandler().moveRight(*this, length - m_ViewData.pos);
 
-  ++line;
-  ++m_ViewData.lineIndex;
+  length = m_Buffer->getLineLength(++m_ViewData.lineIndex);
 
-  if (m_ViewData.pos > line->length()) {
-    m_ViewData.pos = line->length();
+  if (m_ViewData.pos > length) {
+    m_ViewData.pos = length;
     m_ViewData.cursorX = m_ViewData.pos;
   } else if (mode == App::Mode::SELECT) {
     app.getSelectModeHandler().moveRight(*this, m_ViewData.pos + 1);
@@ -286,7 +323,6 @@ void Document::moveCursorDown() {
     ++m_ViewData.cursorY;
   } else {
     ++m_ViewData.offsetY;
-    view.clear();
   }
 }
 
@@ -300,18 +336,33 @@ void Document::moveCursorToBeginningOfLine() {
 }
 
 void Document::moveCursorToEndOfLine() {
-  moveCursorRight(
-    m_Buffer->getConstLineIterator(m_ViewData.lineIndex)->length() -
-    m_ViewData.pos);
+  moveCursorRight(m_Buffer->getLineLength(m_ViewData.lineIndex) -
+                  m_ViewData.pos);
+}
+
+// Puts the cursor at "pos" without going through the positions in between,
+// scrolling only if "pos" isn't already in view.
+void Document::moveCursorTo(std::size_t pos) {
+  auto &view = App::getInstance().getUI().getBufferView();
+  std::size_t height = std::max(view.getHeight(), 1);
+  std::size_t width = std::max(view.getWidth(), 1);
+
+  std::size_t lineIndex = m_Buffer->getLineIndexAtPos(pos);
+  std::size_t column = pos - m_Buffer->getLine(lineIndex).begin();
+  if (lineIndex < m_ViewData.offsetY ||
+      lineIndex >= m_ViewData.offsetY + height)
+    m_ViewData.offsetY = lineIndex >= height ? lineIndex - height + 1 : 0;
+  if (column < m_ViewData.offsetX || column >= m_ViewData.offsetX + width)
+    m_ViewData.offsetX = column >= width ? column - width + 1 : 0;
+
+  m_ViewData.lineIndex = lineIndex;
+  m_ViewData.pos = column;
+  m_ViewData.cursorY = static_cast<int>(lineIndex - m_ViewData.offsetY);
+  m_ViewData.cursorX = static_cast<int>(column - m_ViewData.offsetX);
 }
 
 std::size_t Document::getCursorPosition() const {
-  std::size_t pos = 0;
-  std::for_each(m_Buffer->getFirstLineIterator(),
-                m_Buffer->getConstLineIterator(m_ViewData.lineIndex),
-                [&pos](const auto &line) { pos += line.length() + 1; });
-  pos += m_ViewData.pos;
-  return pos;
+  return m_Buffer->getLine(m_ViewData.lineIndex).begin() + m_ViewData.pos;
 }
 
 unsigned int Document::getViewPortion() const {
@@ -319,24 +370,153 @@ unsigned int Document::getViewPortion() const {
   if (!ui.isCurrentlyRunning() || m_ViewData.offsetY == 0)
     return TOP;
 
-  Buffer::ConstLineIterator lastVisible = m_Buffer->getLastLineIterator();
-  int height = ui.getBufferView().getHeight();
-  auto n = lastVisible - m_Buffer->getConstLineIterator(m_ViewData.offsetY);
+  // Until every Line has been indexed, the best guess at how far down the
+  // view is comes from where its first Line is in the text.
+  if (!m_Buffer->isIndexed()) {
+    double frac =
+      static_cast<double>(m_Buffer->getLine(m_ViewData.offsetY).begin()) /
+      static_cast<double>(m_Buffer->getLength());
+    return static_cast<unsigned int>(frac * 100.0f);
+  }
+
+  std::size_t lastVisible = m_Buffer->getTotalLines() - 1;
+  std::size_t height = ui.getBufferView().getHeight();
+  std::size_t n = lastVisible - m_ViewData.offsetY;
 
   if (n < height)
     return BOTTOM;
 
   lastVisible -= n - height;
 
-  double frac =
-    static_cast<double>(lastVisible - m_Buffer->getFirstLineIterator()) /
-    static_cast<double>(m_Buffer->getTotalLines());
+  double frac = static_cast<double>(lastVisible) /
+                static_cast<double>(m_Buffer->getTotalLines());
   return static_cast<unsigned int>(frac * 100.0f);
 }
 
 void Document::save() {
-  m_File->writeContents(m_Buffer->getStrBuf());
-  m_Dirty = false;
+  if (m_SaveTask) {
+    m_SaveQueued = true;
+    return;
+  }
+  m_SaveFailed = false;
+  // The undo history is written out by the save, along with the text it
+  // leads up to.
+  std::unique_ptr<UndoJournal::Checkpoint> checkpoint;
+  if (m_PersistentUndo)
+    checkpoint = m_EditHistory.takeCheckpoint(m_File->getPath());
+  m_SaveTask = std::make_unique<SaveTask>(
+    m_File->getPath(), m_Buffer->getSnapshot(), std::move(checkpoint));
+  if (m_RecoveryLog)
+    m_RecoveryLog->beginSave();
+}
+
+// Returns true if a save has finished since the last time this was called.
+bool Document::checkOnSave() {
+  if (!m_SaveTask || m_SaveTask->isRunning())
+    return false;
+
+  m_SaveTask->wait();
+  m_EditHistory.endCheckpoint(m_SaveTask->didWriteCheckpoint());
+  if (m_SaveTask->getState() == SaveTask::State::FAILED) {
+    Logger::error("failed to save `%s' -- %s", m_File->getPath().getCString(),
+                  m_SaveTask->getErrorMessage().c_str());
+    m_SaveFailed = true;
+    if (m_RecoveryLog)
+      m_RecoveryLog->endSave(false, false, 0, 0);
+  } else {
+    m_File->update();
+    // Anything edited after the save started still needs to be saved.
+    bool clean = m_Buffer->getVersion() == m_SaveTask->getVersion();
+    if (clean)
+      m_Dirty = false;
+    if (m_RecoveryLog)
+      m_RecoveryLog->endSave(true, clean, m_SaveTask->getLength(),
+                             m_SaveTask->getContentHash());
+  }
+  m_SaveTask.reset();
+
+  if (m_SaveQueued) {
+    m_SaveQueued = false;
+    save();
+  }
+  return true;
+}
+
+// Waits for the running save, and any queued up behind it, to finish.
+void Document::finishSaving() {
+  while (m_SaveTask) {
+    m_SaveTask->wait();
+    checkOnSave();
+  }
+}
+
+void Document::recover() {
+  // The log was written by a Buffer, so every change fit the text it was
+  // made to, but the log itself could have been tampered with since.
+  m_Buffer->beginBatch();
+  for (const RecoveryLog::Change &change : m_RecoverableChanges) {
+    std::size_t len = m_Buffer->getLength();
+    if (change.pos >= len)
+      break;
+    if (change.type == RecoveryLog::Record::Type::INSERT) {
+      m_EditHistory.insert(*m_Buffer, change.pos,
+                           m_RecoverableText.data() + change.textOffset,
+                           change.length);
+    } else {
+      if (change.length >= len - change.pos)
+        break;
+      m_EditHistory.eraseFront(*m_Buffer, change.pos, change.length);
+    }
+  }
+  m_Buffer->endBatch();
+  Logger::info("recovered %zu changes to `%s'", m_RecoverableChanges.size(),
+               m_File->getPath().getCString());
+  m_Dirty = true;
+  discardRecoverableChanges();
+}
+
+void Document::discardRecoverableChanges() {
+  // Once a change is made, the log is started over anyway.
+  if (m_RecoveryLog && !m_Dirty)
+    m_RecoveryLog->discard();
+  m_RecoverableChanges.clear();
+  m_RecoverableChanges.shrink_to_fit();
+  m_RecoverableText.clear();
+  m_RecoverableText.shrink_to_fit();
+}
+
+void Document::closeRecoveryLog() {
+  if (m_RecoveryLog)
+    m_RecoveryLog->close();
+}
+
+// The view is redrawn once a batch is committed rather than after each edit
+// in it.
+void Document::markChanged(std::size_t firstLine, std::size_t lastLine) {
+  if (m_Batching)
+    m_BatchChanged = true;
+  else
+    App::getInstance().getUI().getBufferView().damageLines(firstLine,
+                                                           lastLine);
+  m_Dirty = true;
+}
+
+// Called just before "erased" bytes at "pos" are replaced with the "len" at
+// "str". Only the Line that happens on has to be written again, unless a
+// newline is erased or inserted, which moves every Line after it.
+void Document::markChanged(std::size_t pos, std::size_t erased,
+                           const char *str, std::size_t len) {
+  if (m_Batching) {
+    markChanged();
+    return;
+  }
+  std::size_t last = m_Buffer->getLength() - 1;
+  std::size_t firstLine = m_Buffer->getLineIndexAtPos(std::min(pos, last));
+  std::size_t lastLine = firstLine;
+  if (m_Buffer->getLineIndexAtPos(std::min(pos + erased, last)) != firstLine ||
+      (len != 0 && std::memchr(str, '\n', len)))
+    lastLine = BufferView::TO_END;
+  markChanged(firstLine, lastLine);
 }
 
 void Document::setContentsFromString(const std::string &str) {
@@ -356,6 +536,22 @@ void Document::setContentsFromFile(const std::string &path) {
     return;
   }
 
+  // Past the configured size, map the file instead of reading it. Edits still
+  // go to the piece table's add block, so the mapping is never written to.
+  int mapThreshold =
+    App::getInstance().getFig()->get<int>("MapFilesLargerThanMiB");
+  if (mapThreshold > 0 && m_File->getType() == File::Type::REGULAR &&
+      m_File->getSize() > static_cast<uint64_t>(mapThreshold) * 1024 * 1024) {
+    std::unique_ptr<MappedFile> mapping{m_File->mapContents()};
+    if (mapping) {
+      m_Buffer = std::make_unique<Buffer>(std::move(mapping));
+      m_Mapped = true;
+      return;
+    }
+    Logger::warn("falling back to reading `%s' into memory",
+                 m_File->getPath().getCString());
+  }
+
   std::string contents{m_File->readContents()};
   if (m_File->hadError()) {
     Logger::fatal("failed to read contents from `%s' -- %s",
@@ -363,7 +559,10 @@ void Document::setContentsFromFile(const std::string &path) {
     std::exit(EXIT_FAILURE);
   }
 
-  m_Buffer = std::make_unique<Buffer>(contents);
+  // Files can be arbitrarily large, so keep them in a piece table where an
+  // edit doesn't have to move everything that comes after it.
+  m_Buffer =
+    std::make_unique<Buffer>(std::move(contents), Storage::Type::PIECE_TABLE);
 }
 
 } // namespace jig
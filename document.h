@@ -22,6 +22,8 @@
 #include "edit.h"
 #include "edithistory.h"
 #include "file.h"
+#include "recoverylog.h"
+#include "savetask.h"
 #include "statusbar.h"
 
 namespace jig {
@@ -31,6 +33,8 @@ public:
   static constexpr unsigned int TOP = 0U;
   static constexpr unsigned int BOTTOM = 100U;
 
+  static constexpr long TIME_TRAVEL_STEP_SECS = 60L;
+
   static Document createEmpty(const std::string &title);
   static Document createFromString(const std::string &str,
                                    const std::string &title);
@@ -64,9 +68,26 @@ public:
   Document &replace(std::size_t pos, std::size_t count, char ch);
   Document &replace(std::size_t pos, std::size_t count, std::string &&str);
 
+  // Edits made between beginBatch() and commitBatch() are undone and redone
+  // as one, the Lines are indexed once for all of them, and the view is only
+  // redrawn once they're done. Edits inside a batch should be made at given
+  // positions rather than at the cursor.
+  void beginBatch();
+  void commitBatch();
+
+  // Replaces every occurrence of "from" with "to", as one batch, keeping the
+  // cursor on the text it was on. The final newline is never replaced.
+  // Returns how many occurrences were replaced.
+  std::size_t replaceAll(const std::string &from, const std::string &to);
+
   Document &undo();
   Document &redo();
 
+  // Moves through the undo history TIME_TRAVEL_STEP_SECS at a time, from
+  // whenever the current state was reached, whichever branch that takes.
+  Document &goBackInTime();
+  Document &goForwardInTime();
+
   bool canUndo() const { return m_EditHistory.canUndo(); }
   bool canRedo() const { return m_EditHistory.canRedo(); }
 
@@ -85,10 +106,7 @@ public:
   void moveCursorToBeginningOfLine();
   void moveCursorToEndOfLine();
 
-  unsigned int getCursorLineNumber() const {
-    return m_Buffer->getConstLineIterator(m_ViewData.lineIndex) -
-           m_Buffer->getFirstLineIterator() + 1;
-  }
+  unsigned int getCursorLineNumber() const { return m_ViewData.lineIndex + 1; }
 
   unsigned int getCursorColumnNumber() const { return m_ViewData.pos + 1; }
 
@@ -97,11 +115,35 @@ public:
   unsigned int getViewPortion() const;
 
   bool isDirty() const { return m_Dirty; }
+  bool isMapped() const { return m_Mapped; }
 
+  // Saving happens in the background. save() only starts it, and
+  // checkOnSave() has to be called every so often to find out how it went.
   void save();
+  bool checkOnSave();
+  void finishSaving();
+
+  // Changes that an earlier run made to the file but never saved, found in
+  // the recovery log it left behind. recover() makes them again, as edits
+  // that can be undone.
+  bool hasRecoverableChanges() const { return !m_RecoverableChanges.empty(); }
+  void recover();
+  void discardRecoverableChanges();
+
+  void closeRecoveryLog();
+
+  bool isSaving() const { return m_SaveTask != nullptr; }
+  bool didSaveFail() const { return m_SaveFailed; }
 
 private:
-  Document() = default;
+  Document();
+
+  void moveCursorTo(std::size_t pos);
+
+  void markChanged(std::size_t firstLine = 0,
+                   std::size_t lastLine = BufferView::TO_END);
+  void markChanged(std::size_t pos, std::size_t erased, const char *str,
+                   std::size_t len);
 
   void setContentsFromString(const std::string &str);
   void setContentsFromFile(const std::string &path);
@@ -123,6 +165,27 @@ private:
 
   // Has this Document been modified since the last save?
   bool m_Dirty = false;
+
+  // Is a batch of edits being made, and has it changed anything yet?
+  bool m_Batching = false;
+  bool m_BatchChanged = false;
+
+  // Was the file this Document was loaded from mapped rather than read?
+  bool m_Mapped = false;
+
+  // Is the undo history kept in a journal between runs?
+  bool m_PersistentUndo = false;
+
+  // Every change to a file's text is logged here until it's saved.
+  std::unique_ptr<RecoveryLog> m_RecoveryLog = nullptr;
+  std::vector<RecoveryLog::Change> m_RecoverableChanges;
+  std::string m_RecoverableText;
+
+  // The save that is currently running, if there is one. Asking for another
+  // one while it runs queues it up to start once it's done.
+  std::unique_ptr<SaveTask> m_SaveTask = nullptr;
+  bool m_SaveQueued = false;
+  bool m_SaveFailed = false;
 };
 
 } // namespace jig
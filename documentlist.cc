@@ -37,7 +37,7 @@ void DocumentList::setNextAsCurrent() {
     m_CurrentIndex = 0;
   else
     ++m_CurrentIndex;
-  App::getInstance().getUI().getBufferView().clear();
+  App::getInstance().getUI().getBufferView().damageAll();
 }
 
 void DocumentList::setPreviousAsCurrent() {
@@ -45,7 +45,7 @@ void DocumentList::setPreviousAsCurrent() {
     m_CurrentIndex = m_List.size() - 1;
   else
     --m_CurrentIndex;
-  App::getInstance().getUI().getBufferView().clear();
+  App::getInstance().getUI().getBufferView().damageAll();
 }
 
 } // namespace jig
@@ -20,55 +20,46 @@
 
 namespace jig {
 
-void InsertEdit::apply(Buffer &buffer) {
-  buffer.insert(m_Pos, m_Inserted);
-  m_Applied = true;
+bool Edit::apply(Buffer &buffer, const char *text) {
+  switch (type) {
+    case Type::INSERT:
+      buffer.insert(pos, text, insertedLength);
+      break;
+    case Type::ERASE_BACK:
+      if (erasedLength > pos)
+        return false;
+      buffer.erase(pos - erasedLength, erasedLength);
+      break;
+    case Type::ERASE_FRONT:
+      if (erasedLength > buffer.getLength() - pos)
+        return false;
+      buffer.erase(pos, erasedLength);
+      break;
+    case Type::REPLACE:
+      buffer.replace(pos, erasedLength, text, insertedLength);
+      break;
+  }
+  applied = true;
+  return true;
 }
 
-void InsertEdit::undo(Buffer &buffer) {
-  buffer.erase(m_Pos, m_Inserted.size());
-  m_Applied = false;
-}
-
-void EraseBackEdit::apply(Buffer &buffer) {
-  if (m_Count > m_Pos)
-    return;
-  m_Erased = buffer.getStringAt(m_Pos - m_Count, m_Count);
-  buffer.erase(m_Pos - m_Count, m_Count);
-  m_Applied = true;
-}
-
-void EraseBackEdit::undo(Buffer &buffer) {
-  if (!m_Applied)
-    return;
-  buffer.insert(m_Pos - m_Count, m_Erased);
-  m_Applied = false;
-}
-
-void EraseFrontEdit::apply(Buffer &buffer) {
-  if (m_Count > buffer.getLength() - m_Pos)
+void Edit::undo(Buffer &buffer, const char *text) {
+  if (!applied)
     return;
-  m_Erased = buffer.getStringAt(m_Pos, m_Count);
-  buffer.erase(m_Pos, m_Count);
-  m_Applied = true;
-}
-
-void EraseFrontEdit::undo(Buffer &buffer) {
-  if (!m_Applied)
-    return;
-  buffer.insert(m_Pos, m_Erased);
-  m_Applied = false;
-}
-
-void ReplaceEdit::apply(Buffer &buffer) {
-  m_Erased = buffer.getStringAt(m_Pos, m_Count);
-  buffer.replace(m_Pos, m_Count, m_Inserted);
-  m_Applied = true;
-}
-
-void ReplaceEdit::undo(Buffer &buffer) {
-  buffer.replace(m_Pos, m_Inserted.size(), m_Erased);
-  m_Applied = false;
+  switch (type) {
+    case Type::INSERT:
+      buffer.erase(pos, insertedLength);
+      break;
+    case Type::ERASE_BACK:
+    case Type::ERASE_FRONT:
+      buffer.insert(getErasedPos(), text, erasedLength);
+      break;
+    case Type::REPLACE:
+      buffer.replace(pos, insertedLength, text + insertedLength,
+                     erasedLength);
+      break;
+  }
+  applied = false;
 }
 
 } // namespace jig
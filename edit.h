@@ -17,77 +17,54 @@
 #ifndef __JIG_EDIT_H__
 #define __JIG_EDIT_H__
 
-#include <string>
+#include <cstddef>
+#include <cstdint>
 
 namespace jig {
 
 class Buffer;
 
-class Edit {
-public:
-  Edit(std::size_t pos) : m_Pos{pos} {}
-  virtual void apply(Buffer &buffer) = 0;
-  virtual void undo(Buffer &buffer) = 0;
-  bool isApplied() const { return m_Applied; }
-
-protected:
-  std::size_t m_Pos;
-  bool m_Applied = false;
-};
-
-class InsertEdit : public Edit {
-public:
-  InsertEdit(std::size_t pos, char ch) : Edit{pos}, m_Inserted{ch} {}
-  InsertEdit(std::size_t pos, std::string str)
-    : Edit{pos}, m_Inserted{std::move(str)} {}
-
-  void apply(Buffer &buffer) final;
-  void undo(Buffer &buffer) final;
-
-private:
-  std::string m_Inserted;
-};
-
-class EraseBackEdit : public Edit {
-public:
-  EraseBackEdit(std::size_t pos, std::size_t count)
-    : Edit{pos}, m_Count{count} {}
-
-  void apply(Buffer &buffer) final;
-  void undo(Buffer &buffer) final;
-
-private:
-  std::size_t m_Count;
-  std::string m_Erased;
-};
-
-class EraseFrontEdit : public Edit {
-public:
-  EraseFrontEdit(std::size_t pos, std::size_t count)
-    : Edit{pos}, m_Count{count} {}
-
-  void apply(Buffer &buffer) final;
-  void undo(Buffer &buffer) final;
-
-private:
-  std::size_t m_Count;
-  std::string m_Erased;
-};
-
-class ReplaceEdit : public Edit {
-public:
-  ReplaceEdit(std::size_t pos, std::size_t count, char ch)
-    : Edit{pos}, m_Count{count}, m_Erased{""}, m_Inserted{ch} {}
-  ReplaceEdit(std::size_t pos, std::size_t count, std::string str)
-    : Edit{pos}, m_Count{count}, m_Erased{""}, m_Inserted{std::move(str)} {}
-
-  void apply(Buffer &buffer) final;
-  void undo(Buffer &buffer) final;
-
-private:
-  std::size_t m_Count;
-  std::string m_Erased;
-  std::string m_Inserted;
+// A single change to a Buffer. Edits are plain records that don't own any
+// text. The text they insert or erase is kept elsewhere, by an EditHistory,
+// and handed to apply() and undo() as "text". A REPLACE edit's text is what
+// it inserts followed by what it erased.
+//
+// Edits also make up the nodes of an EditHistory's undo tree. They refer to
+// each other by number, counting from 1 in the order they were made, with 0
+// standing for the text before any of them.
+struct Edit {
+  enum class Type : std::uint8_t { INSERT, ERASE_BACK, ERASE_FRONT, REPLACE };
+
+  // For ERASE_BACK, "pos" is just past the end of the erased text, the way
+  // the cursor is when backspacing.
+  std::size_t pos;
+  std::size_t insertedLength;
+  std::size_t erasedLength;
+  std::size_t textOffset;
+  Type type;
+  bool applied;
+  // Was this made in the same batch as its parent? If so, the two are undone
+  // and redone together.
+  bool joined;
+
+  // The edit this one was made on top of, and the one redo() goes to from
+  // here. "depth" counts the edits between this one and the original text,
+  // including itself.
+  std::size_t parent;
+  std::size_t redoChild;
+  std::size_t depth;
+
+  // When the edit was last changed, in time::getNanosSinceEpoch().
+  std::int64_t time;
+
+  // Returns false, leaving "buffer" alone, if the edit doesn't fit the text.
+  bool apply(Buffer &buffer, const char *text);
+  void undo(Buffer &buffer, const char *text);
+
+  // Where the erased text begins in the Buffer.
+  std::size_t getErasedPos() const {
+    return type == Type::ERASE_BACK ? pos - erasedLength : pos;
+  }
 };
 
 } // namespace jig
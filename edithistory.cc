@@ -16,14 +16,486 @@
 
 #include "edithistory.h"
 
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+#include "buffer.h"
+#include "logger.h"
+
 namespace jig {
 
-void EditHistory::addNew(std::unique_ptr<Edit> &&edit) {
-  std::size_t n = m_List.size();
-  if (n > 0 && m_MostRecentIndex < n - 1)
-    m_List.erase(m_List.begin() + (m_MostRecentIndex + 1), m_List.end());
-  m_List.push_back(std::move(edit));
-  ++m_MostRecentIndex;
+namespace {
+
+// A new word starts wherever something other than whitespace follows
+// whitespace, so e.g. typing "foo bar" is undone as "bar" then "foo ".
+bool isWordBoundary(char before, char after) {
+  return std::isspace(static_cast<unsigned char>(before)) &&
+         !std::isspace(static_cast<unsigned char>(after));
+}
+
+} // namespace
+
+void EditHistory::insert(Buffer &buffer, std::size_t pos, const char *str,
+                         std::size_t len) {
+  checkJournal();
+  if (continuesRun(len) && extendRun(buffer, Edit::Type::INSERT, pos, *str))
+    return;
+  Edit edit{pos, len, 0, getTextEnd(), Edit::Type::INSERT, false};
+  m_Text.append(str, len);
+  addNew(buffer, edit);
+}
+
+void EditHistory::eraseBack(Buffer &buffer, std::size_t pos,
+                            std::size_t count) {
+  checkJournal();
+  if (count > pos)
+    return;
+  if (continuesRun(count) &&
+      extendRun(buffer, Edit::Type::ERASE_BACK, pos, buffer.getCharAt(pos - 1)))
+    return;
+  Edit edit{pos, 0, count, getTextEnd(), Edit::Type::ERASE_BACK, false};
+  appendErased(buffer, pos - count, count);
+  addNew(buffer, edit);
+}
+
+void EditHistory::eraseFront(Buffer &buffer, std::size_t pos,
+                             std::size_t count) {
+  checkJournal();
+  if (count > buffer.getLength() - pos)
+    return;
+  // The Buffer never lets its final newline be erased, so neither does the
+  // Edit, or undoing it would put back a newline that was never taken out.
+  count = std::min(count, buffer.getLength() - 1 - pos);
+  if (count == 0)
+    return;
+  if (continuesRun(count) &&
+      extendRun(buffer, Edit::Type::ERASE_FRONT, pos, buffer.getCharAt(pos)))
+    return;
+  Edit edit{pos, 0, count, getTextEnd(), Edit::Type::ERASE_FRONT, false};
+  appendErased(buffer, pos, count);
+  addNew(buffer, edit);
+}
+
+void EditHistory::replace(Buffer &buffer, std::size_t pos, std::size_t count,
+                          const char *str, std::size_t len) {
+  checkJournal();
+  if (pos >= buffer.getLength())
+    return;
+  count = std::min(count, buffer.getLength() - 1 - pos);
+  m_RunOpen = false;
+  Edit edit{pos, len, count, getTextEnd(), Edit::Type::REPLACE, false};
+  m_Text.append(str, len);
+  appendErased(buffer, pos, count);
+  addNew(buffer, edit);
+}
+
+void EditHistory::undo(Buffer &buffer) {
+  checkJournal();
+  buffer.beginBatch();
+  while (m_Current != 0) {
+    bool joined = getEdit(m_Current).joined;
+    if (!undoCurrent(buffer) || !joined)
+      break;
+  }
+  buffer.endBatch();
+  m_RunOpen = false;
+}
+
+void EditHistory::redo(Buffer &buffer) {
+  checkJournal();
+  buffer.beginBatch();
+  std::size_t next = getRedoChild(m_Current);
+  while (next != 0 && redoTo(buffer, next)) {
+    next = getRedoChild(m_Current);
+    if (next != 0 && !getEdit(next).joined)
+      break;
+  }
+  buffer.endBatch();
+  m_RunOpen = false;
+}
+
+void EditHistory::beginBatch() {
+  m_BatchOpen = true;
+  m_BatchStarted = false;
+  m_BatchTime = time::getNanosSinceEpoch();
+  m_RunOpen = false;
+}
+
+void EditHistory::endBatch() {
+  m_BatchOpen = false;
+}
+
+void EditHistory::goTo(Buffer &buffer, std::size_t edit) {
+  checkJournal();
+  if (edit > getEditCount())
+    return;
+  m_RunOpen = false;
+
+  // Climb from both states to where their branches meet, remembering the
+  // way back down to "edit".
+  std::size_t from = m_Current;
+  std::size_t to = edit;
+  std::vector<std::size_t> path;
+  while (getDepth(from) > getDepth(to))
+    from = getParent(from);
+  while (getDepth(to) > getDepth(from)) {
+    path.push_back(to);
+    to = getParent(to);
+  }
+  while (from != to) {
+    from = getParent(from);
+    path.push_back(to);
+    to = getParent(to);
+  }
+
+  buffer.beginBatch();
+  bool ok = true;
+  while (ok && m_Current != from)
+    ok = undoCurrent(buffer);
+  for (auto it = path.rbegin(); ok && it != path.rend(); ++it)
+    ok = redoTo(buffer, *it);
+  buffer.endBatch();
+}
+
+void EditHistory::goToTime(Buffer &buffer, std::int64_t time) {
+  checkJournal();
+  // Edits are made in order, so their times only ever go up. This finds how
+  // many of them were made by "time".
+  std::size_t low = 0;
+  std::size_t high = getEditCount();
+  while (low < high) {
+    std::size_t mid = low + (high - low) / 2;
+    if (getEdit(mid + 1).time <= time)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  goTo(buffer, low);
+}
+
+std::int64_t EditHistory::getCurrentTime() const {
+  if (m_Current != 0)
+    return getEdit(m_Current).time;
+  return getEditCount() == 0 ? 0 : getEdit(1).time - 1;
+}
+
+// Only edits of a single character make up runs. Anything longer, such as a
+// paste or a cut, ends the run and gets an edit of its own.
+bool EditHistory::continuesRun(std::size_t length) {
+  if (m_BatchOpen || length != 1) {
+    m_RunOpen = false;
+    return false;
+  }
+  m_RunTimer.stop();
+  bool inRun =
+      m_RunOpen && m_RunTimer.getElapsedMillis() <= RUN_TIMEOUT_MILLIS;
+  m_RunOpen = true;
+  m_RunTimer.start();
+  return inRun;
+}
+
+// A run can only grow while it's the newest edit and the current state, in
+// which case its text is at the end of the arena.
+bool EditHistory::extendRun(Buffer &buffer, Edit::Type type, std::size_t pos,
+                            char ch) {
+  if (m_List.empty() || m_Current != getEditCount())
+    return false;
+  Edit &last = m_List.back();
+  if (last.type != type)
+    return false;
+  std::size_t textBegin = last.textOffset - m_TextBase;
+  switch (type) {
+    case Edit::Type::INSERT:
+      if (pos != last.pos + last.insertedLength ||
+          isWordBoundary(m_Text.back(), ch))
+        return false;
+      m_Text.push_back(ch);
+      ++last.insertedLength;
+      buffer.insert(pos, ch);
+      break;
+    case Edit::Type::ERASE_BACK:
+      if (pos != last.getErasedPos() || isWordBoundary(ch, m_Text[textBegin]))
+        return false;
+      m_Text.insert(textBegin, 1, ch);
+      ++last.erasedLength;
+      buffer.erase(pos - 1);
+      break;
+    case Edit::Type::ERASE_FRONT:
+      if (pos != last.pos || isWordBoundary(m_Text.back(), ch))
+        return false;
+      m_Text.push_back(ch);
+      ++last.erasedLength;
+      buffer.erase(pos);
+      break;
+    default:
+      return false;
+  }
+  last.time = time::getNanosSinceEpoch();
+  m_JournaledCount = std::min(m_JournaledCount, m_Current - 1);
+  m_CheckpointCount = std::min(m_CheckpointCount, m_Current - 1);
+  return true;
+}
+
+void EditHistory::appendErased(const Buffer &buffer, std::size_t pos,
+                               std::size_t count) {
+  for (auto it = buffer.getChunks(pos, pos + count); it.isValid(); ++it)
+    m_Text.append((*it).data(), (*it).size());
+}
+
+void EditHistory::addNew(Buffer &buffer, Edit edit) {
+  if (!edit.apply(buffer, getText(edit))) {
+    m_Text.resize(edit.textOffset - m_TextBase);
+    return;
+  }
+  edit.parent = m_Current;
+  edit.redoChild = 0;
+  edit.depth = getDepth(m_Current) + 1;
+  edit.joined = m_BatchOpen && m_BatchStarted;
+  edit.time = m_BatchOpen ? m_BatchTime : time::getNanosSinceEpoch();
+  m_BatchStarted = m_BatchOpen;
+  m_List.push_back(edit);
+  m_Current = getEditCount();
+  setRedoChild(edit.parent, m_Current);
+  enforceMemoryLimit();
+}
+
+bool EditHistory::undoCurrent(Buffer &buffer) {
+  Edit edit = getEdit(m_Current);
+  const char *text = getText(edit);
+  if (!text)
+    return false;
+  edit.undo(buffer, text);
+  if (m_Current > m_LoadedCount)
+    getListed(m_Current).applied = false;
+  setRedoChild(edit.parent, m_Current);
+  m_Current = edit.parent;
+  return true;
+}
+
+// "edit" has to be a child of the current state. An edit that doesn't fit
+// the text isn't redone, so every edit between the current state and the
+// original text is applied.
+bool EditHistory::redoTo(Buffer &buffer, std::size_t edit) {
+  Edit next = getEdit(edit);
+  const char *text = getText(next);
+  if (!text || !next.apply(buffer, text))
+    return false;
+  if (edit > m_LoadedCount)
+    getListed(edit).applied = true;
+  setRedoChild(m_Current, edit);
+  m_Current = edit;
+  return true;
+}
+
+// The journal was only checked against the length of the text when it was
+// loaded. If the text turns out to be different, the history is dropped
+// before anything's done with it.
+void EditHistory::checkJournal() {
+  if (!m_JournalCheck.valid() || m_JournalCheck.get())
+    return;
+  Logger::info("ignoring undo journal `%s' -- the file has changed since",
+               m_Journal->getPath().c_str());
+  m_Journal.reset();
+  m_LoadedCount = 0;
+  m_JournalRedoChildren.clear();
+  m_JournaledCount = 0;
+  m_RedoChildChanged.clear();
+  m_JournalTextLength = 0;
+  m_TextBase = 0;
+  m_Current = 0;
+  m_RootRedoChild = 0;
+}
+
+Edit EditHistory::getEdit(std::size_t edit) const {
+  if (edit > m_LoadedCount)
+    return m_List[edit - m_LoadedCount - 1];
+  UndoJournal::Record record;
+  m_Journal->readRecord(edit - 1, record);
+  Edit result = UndoJournal::toEdit(record);
+  // Only the edits between the current state and the original text are
+  // ever undone, and those are all applied.
+  result.applied = true;
+  // However the journal got this way, the parents have to lead back to the
+  // original text.
+  if (result.parent >= edit)
+    result.parent = 0;
+  auto it = m_JournalRedoChildren.find(edit);
+  if (it != m_JournalRedoChildren.end())
+    result.redoChild = it->second;
+  return result;
+}
+
+// Where redo goes from a loaded edit is only trusted if it really is a child
+// of it.
+std::size_t EditHistory::getRedoChild(std::size_t edit) const {
+  if (edit > m_LoadedCount)
+    return m_List[edit - m_LoadedCount - 1].redoChild;
+  std::size_t child = edit == 0 ? m_RootRedoChild : getEdit(edit).redoChild;
+  if (child <= edit || child > getEditCount() || getParent(child) != edit)
+    return 0;
+  return child;
+}
+
+void EditHistory::setRedoChild(std::size_t edit, std::size_t redoChild) {
+  if (edit == 0)
+    m_RootRedoChild = redoChild;
+  else if (edit > m_LoadedCount)
+    m_List[edit - m_LoadedCount - 1].redoChild = redoChild;
+  else
+    m_JournalRedoChildren[edit] = redoChild;
+  if (edit != 0 && (edit <= m_JournaledCount ||
+                    (m_CheckpointPending && edit <= m_CheckpointCount)))
+    m_RedoChildChanged.insert(edit);
+}
+
+const char *EditHistory::getText(const Edit &edit) {
+  if (edit.textOffset >= m_TextBase)
+    return m_Text.data() + (edit.textOffset - m_TextBase);
+  if (edit.textOffset < m_JournalTextLength) {
+    if (edit.insertedLength + edit.erasedLength >
+        m_JournalTextLength - edit.textOffset)
+      return nullptr;
+    return m_Journal->getText() + edit.textOffset;
+  }
+  // Spilled text is always spilled a whole edit at a time, so all of it can
+  // be read at once.
+  std::size_t length;
+  return m_Spill.read(edit.textOffset - m_JournalTextLength, length);
+}
+
+// Only the text can be spilled, so only the text counts towards the limit.
+void EditHistory::enforceMemoryLimit() {
+  std::size_t usage = m_Text.size();
+  if (m_MemoryLimit == 0 || m_SpillFailed || usage <= m_MemoryLimit)
+    return;
+
+  // Spill down to half the limit, so that it isn't hit again by the very
+  // next edit. The text goes oldest first, and the newest edit's always
+  // stays, so that a run of typing can go on.
+  std::size_t target = m_MemoryLimit / 2;
+  std::size_t end = m_FirstInMemory;
+  while (end + 1 < m_List.size() && usage > target) {
+    usage -= m_List[end].insertedLength + m_List[end].erasedLength;
+    ++end;
+  }
+  if (end == m_FirstInMemory)
+    return;
+  std::size_t length = m_List[end].textOffset - m_TextBase;
+  if (length > 0 && !m_Spill.append(m_Text.data(), length)) {
+    m_SpillFailed = true;
+    return;
+  }
+  m_Text.erase(0, length);
+  m_TextBase += length;
+  m_FirstInMemory = end;
+
+  // Otherwise the memory would stay allocated to the arena.
+  m_Text.shrink_to_fit();
+}
+
+void EditHistory::loadJournal(const Path &filePath, const Buffer &buffer) {
+  auto journal = std::make_shared<UndoJournal>(filePath);
+  if (!journal->open())
+    return;
+
+  UndoJournal::Header header = journal->getHeader();
+  if (header.contentLength != buffer.getLength()) {
+    Logger::info("ignoring undo journal `%s' -- the file has changed since",
+                 journal->getPath().c_str());
+    return;
+  }
+  if (!journal->map())
+    return;
+  m_JournalCheck = std::async(
+    std::launch::async,
+    [](std::unique_ptr<Buffer::Snapshot> snapshot, std::uint64_t hash) {
+      return snapshot->getHash() == hash;
+    },
+    buffer.getSnapshot(), header.contentHash);
+
+  m_Journal = std::move(journal);
+  m_LoadedCount = header.editCount;
+  m_JournalRedoChildren.clear();
+  m_JournaledCount = m_LoadedCount;
+  m_RedoChildChanged.clear();
+  m_List.clear();
+  m_Current = header.current;
+  m_RootRedoChild = header.rootRedoChild;
+  m_JournalTextLength = header.textLength;
+  m_Text.clear();
+  m_TextBase = m_JournalTextLength;
+  m_FirstInMemory = 0;
+  m_Spill = SpillFile{};
+  m_RunOpen = false;
+  Logger::info("loaded %zu edits from the undo journal for `%s'",
+               m_LoadedCount, filePath.getCString());
+}
+
+std::unique_ptr<UndoJournal::Checkpoint>
+EditHistory::takeCheckpoint(const Path &filePath) {
+  checkJournal();
+  if (!m_Journal) {
+    m_Journal = std::make_shared<UndoJournal>(filePath);
+    m_JournaledCount = 0;
+  }
+  auto checkpoint = std::make_unique<UndoJournal::Checkpoint>();
+  checkpoint->journal = m_Journal;
+  checkpoint->keepCount = m_JournaledCount;
+
+  // Only the edits made since the last checkpoint are written, which are
+  // never the ones that were loaded from the journal. Spilled text is read
+  // back a chunk at a time.
+  std::size_t first = m_JournaledCount - m_LoadedCount;
+  if (first < m_List.size()) {
+    for (std::size_t i = first; i < m_List.size(); ++i)
+      checkpoint->records.push_back(UndoJournal::toRecord(m_List[i]));
+    std::size_t offset = m_List[first].textOffset;
+    while (offset < m_TextBase) {
+      std::size_t length;
+      const char *text = m_Spill.read(offset - m_JournalTextLength, length);
+      if (!text)
+        return nullptr;
+      length = std::min(length, m_TextBase - offset);
+      checkpoint->text.append(text, length);
+      offset += length;
+    }
+    checkpoint->text.append(m_Text, offset - m_TextBase, std::string::npos);
+  }
+
+  // The ones that are kept only need where redo goes from them brought up
+  // to date.
+  for (std::size_t edit : m_RedoChildChanged) {
+    if (edit > m_JournaledCount)
+      continue;
+    checkpoint->redoChildren.emplace_back(edit, getEdit(edit).redoChild);
+    m_CheckpointRedoChildren.push_back(edit);
+  }
+  m_RedoChildChanged.clear();
+
+  UndoJournal::Header &header = checkpoint->header;
+  UndoJournal::initHeader(header);
+  header.editCount = getEditCount();
+  header.current = m_Current;
+  header.rootRedoChild = m_RootRedoChild;
+  header.textLength = getTextEnd();
+  m_CheckpointPending = true;
+  m_CheckpointCount = getEditCount();
+  return checkpoint;
+}
+
+void EditHistory::endCheckpoint(bool written) {
+  if (!m_CheckpointPending)
+    return;
+  m_CheckpointPending = false;
+  if (written) {
+    m_JournaledCount = m_CheckpointCount;
+  } else {
+    // They'll have to be written again next time.
+    m_RedoChildChanged.insert(m_CheckpointRedoChildren.begin(),
+                              m_CheckpointRedoChildren.end());
+  }
+  m_CheckpointRedoChildren.clear();
 }
 
 } // namespace jig
@@ -17,31 +17,184 @@
 #ifndef __JIG_EDITHISTORY_H__
 #define __JIG_EDITHISTORY_H__
 
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "edit.h"
+#include "path.h"
+#include "spillfile.h"
+#include "timeutils.h"
+#include "undojournal.h"
 
 namespace jig {
 
 class Buffer;
 
+// Applies edits to a Buffer and keeps them so they can be undone and redone.
+// Each Edit is a fixed-size record, and all of their text is appended to one
+// shared arena instead of being held by each Edit.
+//
+// The edits form a tree. Making an edit after undoing doesn't throw away what
+// was undone, it starts a new branch next to it. Nothing is ever removed, so
+// the edits are simply kept in the order they were made, and each one points
+// at its parent.
 class EditHistory {
 public:
   EditHistory() = default;
   EditHistory(EditHistory &&) = default;
   EditHistory &operator=(EditHistory &&) = default;
 
-  void addNew(std::unique_ptr<Edit> &&edit);
+  // Edits that continue a run of typing (or of backspacing or deleting) are
+  // merged into the most recent edit instead of being added on their own.
+  // A run ends at a word boundary, after a pause of more than
+  // RUN_TIMEOUT_MILLIS, or at an undo or redo. Only single characters are
+  // ever part of one, so a paste, a cut or a replacement is always an undo
+  // step of its own.
+  //
+  // The Buffer's final newline is never erased or replaced.
+  void insert(Buffer &buffer, std::size_t pos, const char *str,
+              std::size_t len);
+  void eraseBack(Buffer &buffer, std::size_t pos, std::size_t count);
+  void eraseFront(Buffer &buffer, std::size_t pos, std::size_t count);
+  void replace(Buffer &buffer, std::size_t pos, std::size_t count,
+               const char *str, std::size_t len);
+
+  // Redo goes back down the branch that was last undone or redone.
+  void undo(Buffer &buffer);
+  void redo(Buffer &buffer);
+
+  // Edits made between these are undone and redone as one. They all get the
+  // same time, so goToTime() never stops partway through them either.
+  void beginBatch();
+  void endBatch();
+
+  bool canUndo() const { return m_Current != 0; }
+  bool canRedo() const { return getRedoChild(m_Current) != 0; }
+
+  // The Buffer is at the state right after edit number getCurrent(), or at
+  // the original text if it's 0.
+  std::size_t getCurrent() const { return m_Current; }
+  std::size_t getEditCount() const { return m_LoadedCount + m_List.size(); }
+
+  // Moves the Buffer to the state right after edit number "edit", on any
+  // branch, by undoing back to where the two states' branches meet and
+  // redoing from there.
+  void goTo(Buffer &buffer, std::size_t edit);
 
-  void undo(Buffer &buffer) { m_List[m_MostRecentIndex--]->undo(buffer); }
-  void redo(Buffer &buffer) { m_List[++m_MostRecentIndex]->apply(buffer); }
+  // Moves the Buffer to the state it was in at "time", i.e. right after the
+  // last edit made by then, in time::getNanosSinceEpoch().
+  void goToTime(Buffer &buffer, std::int64_t time);
 
-  bool canUndo() const { return m_MostRecentIndex > -1; }
-  bool canRedo() const { return m_MostRecentIndex != m_List.size() - 1; }
+  // When the current state was reached by an edit. The original text counts
+  // as just before the first edit.
+  std::int64_t getCurrentTime() const;
+
+  // Once the text kept in memory takes up more than "bytes", the text of the
+  // oldest edits is spilled to disk, and read back in when undo or redo
+  // reaches them. 0 means there is no limit.
+  void setMemoryLimit(std::size_t bytes) { m_MemoryLimit = bytes; }
+
+  std::size_t getMemoryUsage() const {
+    return m_List.size() * sizeof(Edit) + m_Text.size();
+  }
+
+  // Picks up the history saved by the last checkpoint for "filePath", as
+  // long as "buffer" holds the text that was saved along with it. Only the
+  // journal's Header is read here. Its edits and their text stay in the
+  // journal and are read when they're needed, and the text is hashed on
+  // another thread, which the history waits for when it's first used.
+  void loadJournal(const Path &filePath, const Buffer &buffer);
+
+  // Copies out what has to be written to save the history for "filePath",
+  // as of the current state, so it can be written along with the file. The
+  // history has to be told with endCheckpoint() whether it was.
+  std::unique_ptr<UndoJournal::Checkpoint>
+  takeCheckpoint(const Path &filePath);
+  void endCheckpoint(bool written);
 
 private:
-  std::vector<std::unique_ptr<Edit>> m_List;
-  ssize_t m_MostRecentIndex = -1;
+  static constexpr long RUN_TIMEOUT_MILLIS = 1000L;
+
+  bool continuesRun(std::size_t length);
+  bool extendRun(Buffer &buffer, Edit::Type type, std::size_t pos, char ch);
+  void appendErased(const Buffer &buffer, std::size_t pos, std::size_t count);
+  void addNew(Buffer &buffer, Edit edit);
+
+  bool undoCurrent(Buffer &buffer);
+  bool redoTo(Buffer &buffer, std::size_t edit);
+
+  void checkJournal();
+
+  // Edits that were loaded from the journal are read from it, so these all
+  // return copies.
+  Edit getEdit(std::size_t edit) const;
+  std::size_t getRedoChild(std::size_t edit) const;
+  void setRedoChild(std::size_t edit, std::size_t redoChild);
+  std::size_t getParent(std::size_t edit) const {
+    return edit == 0 ? 0 : getEdit(edit).parent;
+  }
+  std::size_t getDepth(std::size_t edit) const {
+    return edit == 0 ? 0 : getEdit(edit).depth;
+  }
+
+  // Only for edits made since the history was loaded.
+  Edit &getListed(std::size_t edit) { return m_List[edit - m_LoadedCount - 1]; }
+
+  // Where the next edit's text goes, counting all of the history's text.
+  std::size_t getTextEnd() const { return m_TextBase + m_Text.size(); }
+
+  // Returns nullptr if the text was spilled and can't be read back.
+  const char *getText(const Edit &edit);
+
+  void enforceMemoryLimit();
+
+  // The edits made since the history was loaded. The ones before them are
+  // only in the journal.
+  std::vector<Edit> m_List;
+  std::size_t m_Current = 0;
+  std::size_t m_RootRedoChild = 0;
+  bool m_RunOpen = false;
+  time::Timer m_RunTimer;
+  bool m_BatchOpen = false;
+  bool m_BatchStarted = false;
+  std::int64_t m_BatchTime = 0;
+
+  // Each Edit's textOffset counts all of the history's text, in the order
+  // the edits were made. The first m_JournalTextLength bytes of it are in
+  // the journal it was loaded from, the next are in m_Spill, and the rest,
+  // from m_TextBase on, are in m_Text. m_FirstInMemory is the first edit in
+  // m_List whose text is in m_Text.
+  std::string m_Text;
+  std::size_t m_TextBase = 0;
+  std::size_t m_JournalTextLength = 0;
+  std::size_t m_FirstInMemory = 0;
+  SpillFile m_Spill;
+  std::size_t m_MemoryLimit = 0;
+  bool m_SpillFailed = false;
+
+  // The journal the history was loaded from or last saved to, and whether
+  // the text it was loaded against has been found to match yet. The first
+  // m_LoadedCount edits were loaded from it, and once where redo goes from
+  // one of them changes, that's kept in m_JournalRedoChildren.
+  std::shared_ptr<UndoJournal> m_Journal;
+  std::future<bool> m_JournalCheck;
+  std::size_t m_LoadedCount = 0;
+  std::unordered_map<std::size_t, std::size_t> m_JournalRedoChildren;
+
+  // The first m_JournaledCount edits are the same in the journal as they are
+  // here, apart from the redoChild of those in m_RedoChildChanged. While a
+  // checkpoint is being written, m_CheckpointCount is how many will be, and
+  // m_CheckpointRedoChildren are the redoChildren it writes.
+  std::size_t m_JournaledCount = 0;
+  std::unordered_set<std::size_t> m_RedoChildChanged;
+  bool m_CheckpointPending = false;
+  std::size_t m_CheckpointCount = 0;
+  std::vector<std::size_t> m_CheckpointRedoChildren;
 };
 
 } // namespace jig
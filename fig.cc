@@ -16,7 +16,10 @@
 
 #include "fig.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cstdlib>
+#include <iterator>
 #include <utility>
 
 #include "logger.h"
@@ -31,37 +34,61 @@ constexpr char EQUAL_CHAR = '=';
 constexpr char BUILTIN_FIG[] = "WrapLines=false\n"
                                "ShowLineNumbers=false\n"
                                "UseSpacesForTabs=false\n"
-                               "TabWidth=4\n";
+                               "TabWidth=4\n"
+                               "MapFilesLargerThanMiB=256\n"
+                               "UndoMemoryLimitMiB=64\n"
+                               "PersistentUndo=true\n"
+                               "RecoveryLogFlushMillis=200\n";
+
+struct Option {
+  const char *name;
+  Settings::ValueType type;
+};
 
-const std::unordered_map<std::string, Settings::ValueType> VALID_OPTIONS = {
+constexpr Option VALID_OPTIONS[] = {
   {"WrapLines", Settings::ValueType::BOOLEAN},
   {"ShowLineNumbers", Settings::ValueType::BOOLEAN},
   {"UseSpacesForTabs", Settings::ValueType::BOOLEAN},
   {"TabWidth", Settings::ValueType::NUMBER},
+  {"MapFilesLargerThanMiB", Settings::ValueType::NUMBER},
+  {"UndoMemoryLimitMiB", Settings::ValueType::NUMBER},
+  {"PersistentUndo", Settings::ValueType::BOOLEAN},
+  {"RecoveryLogFlushMillis", Settings::ValueType::NUMBER},
 };
 
 const Path BUILTIN_FIG_DUMMY_PATH = "";
 
-void stripComments(std::string &line) {
-  std::size_t p = line.find_first_of(COMMENT_CHAR);
-  if (p != std::string::npos)
-    line.erase(p);
+const Option *findOption(StringRef name) {
+  for (const auto &option : VALID_OPTIONS)
+    if (name == option.name)
+      return &option;
+  return nullptr;
+}
+
+bool isSpace(char c) {
+  return std::isspace(static_cast<unsigned char>(c)) != 0;
 }
 
-void preprocessLine(std::string &line) {
-  stripComments(line);
-  if (line.empty())
-    return;
-  str::stripAllWhitespace(line);
+// Cuts off any comment and drops whitespace from anywhere in the line. Only
+// a line that has some whitespace to drop is copied, into "scratch".
+StringRef preprocessLine(StringRef line, std::string &scratch) {
+  line = line.substr(0, line.find(COMMENT_CHAR));
+  if (std::none_of(line.begin(), line.end(), isSpace))
+    return line;
+  scratch.clear();
+  std::remove_copy_if(line.begin(), line.end(), std::back_inserter(scratch),
+                      isSpace);
+  return StringRef{scratch};
 }
 
-std::pair<std::string, std::string> processLine(const std::string &line) {
-  if (str::occurs(line, EQUAL_CHAR) != 1) {
-    Logger::error("config syntax error in line: `%s'", line.c_str());
+std::pair<StringRef, StringRef> processLine(StringRef line) {
+  if (str::occurs(line.data(), line.size(), EQUAL_CHAR) != 1) {
+    Logger::error("config syntax error in line: `%.*s'",
+                  static_cast<int>(line.size()), line.data());
     Logger::error("--> Each line can only logically contain one '=' character");
     std::abort();
   }
-  std::size_t p = line.find_first_of(EQUAL_CHAR);
+  std::size_t p = line.find(EQUAL_CHAR);
   return std::make_pair(line.substr(0, p), line.substr(p + 1));
 }
 
@@ -84,6 +111,14 @@ Fig::Fig(const Path &path) : m_File{nullptr}, m_Buffer{BUILTIN_FIG} {
   Logger::info("UseSpacesForTabs -> %s",
                m_Settings.get<bool>("UseSpacesForTabs") ? "true" : "false");
   Logger::info("TabWidth -> %d", m_Settings.get<int>("TabWidth"));
+  Logger::info("MapFilesLargerThanMiB -> %d",
+               m_Settings.get<int>("MapFilesLargerThanMiB"));
+  Logger::info("UndoMemoryLimitMiB -> %d",
+               m_Settings.get<int>("UndoMemoryLimitMiB"));
+  Logger::info("PersistentUndo -> %s",
+               m_Settings.get<bool>("PersistentUndo") ? "true" : "false");
+  Logger::info("RecoveryLogFlushMillis -> %d",
+               m_Settings.get<int>("RecoveryLogFlushMillis"));
 }
 
 const Path &Fig::getPath() const {
@@ -93,40 +128,37 @@ const Path &Fig::getPath() const {
 }
 
 void Fig::parseSettings() {
-  static const auto INVALID_OPTION = VALID_OPTIONS.end();
+  std::string lineScratch;
+  std::string strippedScratch;
 
-  for (auto B = m_Buffer.getFirstLineIterator(),
-            E = m_Buffer.getLastLineIterator() + 1, I = B;
-       I != E; ++I) {
-    std::string line{m_Buffer.getLineAt(I - B)};
-    preprocessLine(line);
+  for (std::size_t i = 0, n = m_Buffer.getTotalLines(); i < n; ++i) {
+    StringRef line{m_Buffer.getLineRefAt(i, lineScratch)};
+    line = preprocessLine(line, strippedScratch);
     if (line.empty())
       continue;
     auto kv = processLine(line);
-    auto p = VALID_OPTIONS.find(kv.first);
-    if (p == INVALID_OPTION) {
-      Logger::warn("encountered invalid config option -- `%s'",
-                   kv.first.c_str());
+    const Option *option = findOption(kv.first);
+    if (!option) {
+      Logger::warn("encountered invalid config option -- `%.*s'",
+                   static_cast<int>(kv.first.size()), kv.first.data());
       continue;
     }
-    if (p->second != Settings::getRealValueTypeForValueAsString(kv.second)) {
-      Logger::warn("config option `%s' expects %s values", kv.first.c_str(),
-                   Settings::getValueTypeString(p->second));
+    auto type = Settings::getRealValueTypeForValueAsString(kv.second);
+    if (type != option->type) {
+      Logger::warn("config option `%s' expects %s values", option->name,
+                   Settings::getValueTypeString(option->type));
       continue;
     }
-    switch (p->second) {
+    switch (option->type) {
       case Settings::ValueType::BOOLEAN:
-        m_Settings.set<bool>(kv.first,
+        m_Settings.set<bool>(option->name,
                              Settings::convertStringToBoolean(kv.second));
         break;
       case Settings::ValueType::NUMBER:
-        m_Settings.set<int>(kv.first,
+        m_Settings.set<int>(option->name,
                             Settings::convertStringToNumber(kv.second));
         break;
-      case Settings::ValueType::STRING:
-        m_Settings.set<const char *>(kv.first, kv.second.c_str());
-        break;
-      default: // not reached
+      default: // not reached: no option takes a string
         break;
     }
   }
@@ -16,17 +16,69 @@
 
 #include "file.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include <assert.h>
+#include <atomic>
 #include <cerrno>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
 #include "logger.h"
+#include "timeutils.h"
 #include "util.h"
 
 namespace jig {
 namespace {
 
+// The most that is asked of a single read(2) call.
+constexpr std::size_t READ_CHUNK_SIZE = 16 * 1024 * 1024;
+
+// Writes smaller than this are gathered up before being passed to write(2).
+constexpr std::size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+std::string getDirectoryOf(const std::string &path) {
+  std::size_t p = path.find_last_of(Path::SEPARATOR);
+  if (p == std::string::npos)
+    return ".";
+  if (p == 0)
+    return std::string(1, Path::SEPARATOR);
+  return path.substr(0, p);
+}
+
+// Like mkstemp(), except that the file is created as 0666 less the umask,
+// the way any other new file would be. Finding out the umask means changing
+// it, which would race with every other thread that creates a file.
+int createTempFile(std::string &path) {
+  static constexpr char LETTERS[] =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  static constexpr std::size_t N_LETTERS = sizeof(LETTERS) - 1;
+  static constexpr int MAX_ATTEMPTS = 100;
+  static std::atomic<std::uint64_t> counter{0};
+
+  std::size_t suffix = path.rfind("XXXXXX");
+  assert(suffix != std::string::npos && "No XXXXXX to replace");
+  std::uint64_t seed = static_cast<std::uint64_t>(time::getNanosSinceEpoch()) ^
+                       (static_cast<std::uint64_t>(getpid()) << 32);
+  for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+    std::uint64_t v = (seed + ++counter) * UINT64_C(0x9e3779b97f4a7c15);
+    for (std::size_t i = 0; i < 6; ++i) {
+      path[suffix + i] = LETTERS[v % N_LETTERS];
+      v /= N_LETTERS;
+    }
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                    0666);
+    if (fd != -1 || errno != EEXIST)
+      return fd;
+  }
+  errno = EEXIST;
+  return -1;
+}
+
 File::Type getTypeFromMode(mode_t m) {
   if (S_ISBLK(m))
     return File::Type::BLOCK_DEVICE;
@@ -107,47 +159,250 @@ void File::writeByte(int byte) {
 }
 
 std::string File::readContents() {
-  open();
-  if (hadError())
+  time::Timer timer;
+  timer.start();
+
+  m_Error = 0;
+  int fd = ::open(m_Path.getCString(), O_RDONLY);
+  if (fd == -1) {
+    m_Error = errno;
+    Logger::error("failed to open file `%s' -- %s", m_Path.getCString(),
+                  std::strerror(m_Error));
     return "";
+  }
+
+  // Size the string up front and read straight into it. For anything that
+  // doesn't report its size (like a pipe), start small and let it grow.
+  struct stat statBuf;
+  std::size_t size = READ_CHUNK_SIZE;
+  if (fstat(fd, &statBuf) == 0 && S_ISREG(statBuf.st_mode))
+    size = static_cast<std::size_t>(statBuf.st_size);
 
   std::string contents;
-  contents.reserve(m_Size);
+  contents.resize(size);
 
-  int ch;
+  std::size_t total = 0;
+  char probe[4096];
   while (true) {
-    ch = std::fgetc(m_FPtr);
-    if (ch == EOF)
+    ssize_t n;
+    if (total < contents.size()) {
+      std::size_t want = contents.size() - total;
+      if (want > READ_CHUNK_SIZE)
+        want = READ_CHUNK_SIZE;
+      n = ::read(fd, &contents[total], want);
+    } else {
+      // The string is full. Either this is the end of the file, or the file
+      // was bigger than it said it was.
+      n = ::read(fd, probe, sizeof(probe));
+      if (n > 0)
+        contents.append(probe, n);
+    }
+    if (n == 0)
       break;
-    contents += static_cast<char>(ch);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      m_Error = errno;
+      ::close(fd);
+      Logger::error("failed to read contents from file `%s' -- %s",
+                    m_Path.getCString(), std::strerror(m_Error));
+      return "";
+    }
+    total += n;
   }
 
-  if (std::ferror(m_FPtr)) {
-    close();
+  ::close(fd);
+  contents.resize(total);
+
+  timer.stop();
+  long nanos = timer.getElapsedNanos();
+  double mibPerSec = 0.0;
+  if (nanos > 0)
+    mibPerSec = (static_cast<double>(total) / (1024.0 * 1024.0)) /
+                (static_cast<double>(nanos) / time::Timer::NANOS_PER_SEC);
+  Logger::info("read %zu bytes from `%s' in %ldms (%.1f MiB/s)", total,
+               m_Path.getCString(), timer.getElapsedMillis(), mibPerSec);
+  return contents;
+}
+
+std::unique_ptr<MappedFile> File::mapContents() {
+  m_Error = 0;
+  int fd = ::open(m_Path.getCString(), O_RDONLY);
+  if (fd == -1) {
     m_Error = errno;
-    Logger::error("failed to read contents from file `%s' -- %s",
-                  m_Path.getCString(), std::strerror(m_Error));
-    return "";
+    Logger::error("failed to open file `%s' -- %s", m_Path.getCString(),
+                  std::strerror(m_Error));
+    return nullptr;
   }
 
-  close();
-  return contents;
+  struct stat statBuf;
+  if (fstat(fd, &statBuf) == -1) {
+    m_Error = errno;
+    ::close(fd);
+    Logger::error("failed to stat file `%s' -- %s", m_Path.getCString(),
+                  std::strerror(m_Error));
+    return nullptr;
+  }
+
+  // An empty file can't be mapped, but there's nothing to map anyway.
+  std::size_t size = static_cast<std::size_t>(statBuf.st_size);
+  if (size == 0) {
+    ::close(fd);
+    return std::make_unique<MappedFile>(nullptr, 0);
+  }
+
+  void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    m_Error = errno;
+    ::close(fd);
+    Logger::error("failed to map file `%s' -- %s", m_Path.getCString(),
+                  std::strerror(m_Error));
+    return nullptr;
+  }
+
+  // The mapping stays valid after the descriptor is closed.
+  ::close(fd);
+  Logger::info("mapped %zu bytes from `%s'", size, m_Path.getCString());
+  return std::make_unique<MappedFile>(static_cast<const char *>(data), size);
 }
 
 void File::writeContents(const std::string &contents) {
-  open("wb");
-  if (hadError())
+  beginAtomicWrite();
+  write(contents.data(), contents.size());
+  commitAtomicWrite();
+}
+
+void File::beginAtomicWrite() {
+  assert(m_WriteFd == -1 && "An atomic write is already in progress");
+  m_Error = 0;
+
+  // Write through symlinks rather than replacing them with a regular file.
+  m_WriteTarget = m_Path.getString();
+  char *resolved = realpath(m_Path.getCString(), nullptr);
+  if (resolved) {
+    m_WriteTarget = resolved;
+    std::free(resolved);
+  }
+
+  m_TempPath = getDirectoryOf(m_WriteTarget);
+  m_TempPath += Path::SEPARATOR;
+  m_TempPath += '.';
+  m_TempPath +=
+    m_WriteTarget.substr(m_WriteTarget.find_last_of(Path::SEPARATOR) + 1);
+  m_TempPath += ".jig-XXXXXX";
+
+  m_WriteFd = createTempFile(m_TempPath);
+  if (m_WriteFd == -1) {
+    m_Error = errno;
+    Logger::error("failed to create temporary file `%s' -- %s",
+                  m_TempPath.c_str(), std::strerror(m_Error));
+    return;
+  }
+
+  // Give the file the ownership and permissions of the one it's replacing.
+  struct stat statBuf;
+  if (stat(m_WriteTarget.c_str(), &statBuf) == 0) {
+    if (fchown(m_WriteFd, statBuf.st_uid, statBuf.st_gid) == -1)
+      Logger::warn("unable to preserve ownership of `%s' -- %s",
+                   m_Path.getCString(), std::strerror(errno));
+    fchmod(m_WriteFd, statBuf.st_mode & 07777);
+  }
+
+  m_WriteBuffer = std::make_unique<char[]>(WRITE_BUFFER_SIZE);
+  m_WriteBufferUsed = 0;
+}
+
+void File::write(const char *data, std::size_t len) {
+  if (m_WriteFd == -1 || hadError())
+    return;
+
+  if (m_WriteBufferUsed + len > WRITE_BUFFER_SIZE)
+    flushWriteBuffer();
+
+  // Anything too big to be worth buffering goes straight through.
+  if (len >= WRITE_BUFFER_SIZE) {
+    writeAll(data, len);
+    return;
+  }
+
+  std::memcpy(m_WriteBuffer.get() + m_WriteBufferUsed, data, len);
+  m_WriteBufferUsed += len;
+}
+
+void File::commitAtomicWrite() {
+  if (m_WriteFd == -1)
+    return;
+
+  flushWriteBuffer();
+  if (!hadError() && fsync(m_WriteFd) == -1) {
+    m_Error = errno;
+    Logger::error("failed to sync `%s' -- %s", m_TempPath.c_str(),
+                  std::strerror(m_Error));
+  }
+  if (hadError()) {
+    abortAtomicWrite();
+    return;
+  }
+
+  ::close(m_WriteFd);
+  m_WriteFd = -1;
+  m_WriteBuffer.reset();
+
+  if (rename(m_TempPath.c_str(), m_WriteTarget.c_str()) == -1) {
+    m_Error = errno;
+    Logger::error("failed to rename `%s' to `%s' -- %s", m_TempPath.c_str(),
+                  m_WriteTarget.c_str(), std::strerror(m_Error));
+    unlink(m_TempPath.c_str());
     return;
+  }
+
+  // The rename itself only survives a crash once the directory is synced.
+  int dirFd =
+    ::open(getDirectoryOf(m_WriteTarget).c_str(), O_RDONLY | O_DIRECTORY);
+  if (dirFd != -1) {
+    fsync(dirFd);
+    ::close(dirFd);
+  }
 
-  std::fwrite(contents.data(), sizeof(std::string::value_type), contents.size(),
-              m_FPtr);
-  close();
+  update();
+}
+
+void File::abortAtomicWrite() {
+  if (m_WriteFd == -1)
+    return;
+  ::close(m_WriteFd);
+  m_WriteFd = -1;
+  m_WriteBuffer.reset();
+  unlink(m_TempPath.c_str());
 }
 
 const char *File::errorMessage() const {
   return std::strerror(m_Error);
 }
 
+void File::flushWriteBuffer() {
+  if (m_WriteBufferUsed == 0)
+    return;
+  writeAll(m_WriteBuffer.get(), m_WriteBufferUsed);
+  m_WriteBufferUsed = 0;
+}
+
+void File::writeAll(const char *data, std::size_t len) {
+  while (len != 0 && !hadError()) {
+    ssize_t n = ::write(m_WriteFd, data, len);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      m_Error = errno;
+      Logger::error("failed to write to `%s' -- %s", m_TempPath.c_str(),
+                    std::strerror(m_Error));
+      return;
+    }
+    data += n;
+    len -= n;
+  }
+}
+
 void File::initStats() {
   struct stat statBuf;
 
@@ -19,8 +19,10 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <memory>
 #include <string>
 
+#include "mappedfile.h"
 #include "path.h"
 
 namespace jig {
@@ -48,6 +50,8 @@ public:
   ~File() {
     if (m_FPtr)
       close();
+    if (m_WriteFd != -1)
+      abortAtomicWrite();
   }
 
   const Path &getPath() const { return m_Path; }
@@ -66,13 +70,25 @@ public:
   bool isOpen() const { return m_FPtr != nullptr; }
 
   std::string readContents();
+  std::unique_ptr<MappedFile> mapContents();
   void writeContents(const std::string &contents);
 
+  // Replaces the contents of the file atomically. Everything written goes to
+  // a temporary file in the same directory, which is only renamed over this
+  // one once it has all been written and synced to disk. If anything fails
+  // before then, the file is left as it was.
+  void beginAtomicWrite();
+  void write(const char *data, std::size_t len);
+  void commitAtomicWrite();
+  void abortAtomicWrite();
+
   bool hadError() const { return m_Error != 0; }
   const char *errorMessage() const;
 
 private:
   void initStats();
+  void flushWriteBuffer();
+  void writeAll(const char *data, std::size_t len);
 
   Path m_Path;
   std::FILE *m_FPtr = nullptr;
@@ -80,6 +96,13 @@ private:
   Type m_Type = Type::UNKNOWN;
   int m_Error = 0;
   bool m_Exists = false;
+
+  // Only used while an atomic write is in progress.
+  std::string m_WriteTarget;
+  std::string m_TempPath;
+  int m_WriteFd = -1;
+  std::unique_ptr<char[]> m_WriteBuffer;
+  std::size_t m_WriteBufferUsed = 0;
 };
 
 } // namespace jig
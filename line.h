@@ -17,32 +17,25 @@
 #ifndef __JIG_LINE_H__
 #define __JIG_LINE_H__
 
-#include <string>
+#include <cstddef>
 
 namespace jig {
 
 class Line {
 public:
-  Line(std::string::iterator b, std::string::iterator e)
-    : m_Begin{b}, m_End{e} {}
+  Line(std::size_t b, std::size_t e) : m_Begin{b}, m_End{e} {}
 
   std::size_t length() const { return m_End - m_Begin; }
   std::size_t size() const { return m_End - m_Begin; }
 
-  std::string toString() const {
-    std::string ret;
-    std::for_each(m_Begin, m_End + 1, [&ret](const char &ch) { ret += ch; });
-    return ret;
-  }
-
-  auto &begin() { return m_Begin; }
-  const auto &begin() const { return m_Begin; }
-  auto &end() { return m_End; }
-  const auto &end() const { return m_End; }
+  // Positions of the first character of this Line and of the newline that
+  // terminates it.
+  std::size_t begin() const { return m_Begin; }
+  std::size_t end() const { return m_End; }
 
 private:
-  std::string::iterator m_Begin;
-  std::string::iterator m_End;
+  std::size_t m_Begin;
+  std::size_t m_End;
 };
 
 } // namespace jig
@@ -0,0 +1,263 @@
+//===--- lineindex.cc ---------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "lineindex.h"
+
+#include <assert.h>
+
+#include "chunkiterator.h"
+#include "storage.h"
+#include "strutils.h"
+
+namespace jig {
+namespace {
+
+// Calls "func" with the position of every newline in "storage" from "pos" up
+// to "end", for as long as it keeps returning true.
+template <typename Func>
+void forEachNewline(const Storage &storage, std::size_t pos, std::size_t end,
+                    Func func) {
+  // The newlines are found a batch at a time, which is much faster than
+  // looking for them one at a time when the Lines are short. The batches
+  // start out small, since an edit usually only needs the next one or two.
+  std::size_t offsets[256];
+  std::size_t batch = 1;
+  for (ChunkIterator<Storage> it{storage, pos, end}; it.isValid(); ++it) {
+    StringRef span = *it;
+    pos = it.getPos();
+    for (std::size_t off = 0; off < span.size();) {
+      std::size_t searched;
+      std::size_t n = str::findAll(span.data() + off, span.size() - off, '\n',
+                                   offsets, batch, searched);
+      for (std::size_t i = 0; i < n; ++i)
+        if (!func(pos + off + offsets[i]))
+          return;
+      off += searched;
+      if (batch < 256)
+        batch *= 4;
+    }
+  }
+}
+
+} // namespace
+
+// Forgets everything that has been indexed so far. Nothing is indexed again
+// until it's asked for.
+void LineIndex::reset(const Storage &storage) {
+  m_Starts32.clear();
+  m_Starts64.clear();
+  m_Wide = false;
+  setRawStart(0, 0);
+  m_ShiftFrom = getTotalStarts();
+  m_ShiftDelta = 0;
+  m_ScanPos = 0;
+  m_Complete = storage.getLength() == 0;
+}
+
+void LineIndex::indexThroughLine(const Storage &storage,
+                                 std::size_t lineIndex) {
+  if (m_Complete || lineIndex < getTotalLines())
+    return;
+  scan(storage, storage.getLength(),
+       [this, lineIndex]() { return lineIndex < getTotalLines(); });
+}
+
+void LineIndex::indexThroughPos(const Storage &storage, std::size_t pos) {
+  if (m_Complete || pos < getFrontier())
+    return;
+  scan(storage, storage.getLength(),
+       [this, pos]() { return pos < getFrontier(); });
+}
+
+void LineIndex::indexMore(const Storage &storage, std::size_t count) {
+  if (m_Complete)
+    return;
+  std::size_t end = storage.getLength();
+  if (end - m_ScanPos > count)
+    end = m_ScanPos + count;
+  scan(storage, end, []() { return false; });
+}
+
+void LineIndex::indexAll(const Storage &storage) {
+  if (m_Complete)
+    return;
+  scan(storage, storage.getLength(), []() { return false; });
+}
+
+// Called after "erased" bytes at "pos" have been replaced with "inserted" new
+// ones. "pos" and "erased" describe the text as it was before the edit, which
+// is also what this index still describes at this point.
+void LineIndex::update(const Storage &storage, std::size_t pos,
+                       std::size_t erased, std::size_t inserted) {
+  // Edits past the part of the text that has been indexed will be picked up
+  // when that part is scanned. Edits that reach into it from before only need
+  // the index to be cut back to the Line they begin on.
+  std::size_t frontier = getFrontier();
+  if (pos >= frontier) {
+    if (pos < m_ScanPos)
+      m_ScanPos = pos;
+    m_Complete = false;
+    return;
+  }
+  if (pos + erased >= frontier) {
+    truncate(findLineIndex(pos) + 1);
+    m_ScanPos = getFrontier();
+    m_Complete = false;
+    return;
+  }
+
+  std::size_t first = findLineIndex(pos);
+  std::size_t last = findLineIndex(pos + erased);
+  std::size_t begin = getStart(first);
+  std::ptrdiff_t delta = static_cast<std::ptrdiff_t>(inserted) -
+                         static_cast<std::ptrdiff_t>(erased);
+
+  // The entries from first + 1 up to and including last + 1 are about to be
+  // replaced. Settle the pending shift between them and m_ShiftFrom, so that
+  // after this edit there is still only one point where it starts to apply.
+  // The cost of this is proportional to how far this edit is from the last
+  // one.
+  if (m_ShiftDelta == 0) {
+    m_ShiftFrom = last + 2;
+  } else if (m_ShiftFrom <= first) {
+    shift(m_ShiftFrom, first + 1, m_ShiftDelta);
+    m_ShiftFrom = last + 2;
+  } else if (m_ShiftFrom > last + 2) {
+    shift(last + 2, m_ShiftFrom, delta);
+  }
+
+  // Re-split only the Lines the edit touched: from the beginning of the first
+  // one up to the newline that ends the last one.
+  std::vector<std::size_t> starts;
+  std::size_t stop = pos + inserted;
+  forEachNewline(storage, begin, storage.getLength(),
+                 [&starts, stop](std::size_t pos) {
+                   starts.push_back(pos + 1);
+                   return pos < stop;
+                 });
+
+  std::size_t count = last - first + 1;
+  splice(first + 1, count, starts);
+
+  if (m_ShiftFrom <= last + 2)
+    m_ShiftFrom = first + starts.size() + 1;
+  else
+    m_ShiftFrom = m_ShiftFrom + starts.size() - count;
+  m_ShiftDelta += delta;
+  m_ScanPos += delta;
+
+  if (m_ShiftFrom >= getTotalStarts()) {
+    m_ShiftFrom = getTotalStarts();
+    m_ShiftDelta = 0;
+  }
+}
+
+// Binary search for the last Line that begins at or before "pos".
+std::size_t LineIndex::findLineIndex(std::size_t pos) const {
+  std::size_t lo = 0;
+  std::size_t hi = getTotalLines();
+  while (hi - lo > 1) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    if (getStart(mid) <= pos)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Searches on from m_ScanPos up to "end", recording where each Line begins,
+// until "done" returns true.
+template <typename Done>
+void LineIndex::scan(const Storage &storage, std::size_t end, Done done) {
+  bool stopped = false;
+  forEachNewline(storage, m_ScanPos, end, [&](std::size_t pos) {
+    // Anything from m_ShiftFrom onwards is stored before the pending shift
+    // is applied, and so is every entry that gets added at the end.
+    setRawStart(getTotalStarts(), pos + 1 - m_ShiftDelta);
+    m_ScanPos = pos + 1;
+    stopped = done();
+    return !stopped;
+  });
+  if (!stopped)
+    m_ScanPos = end;
+  m_Complete = m_ScanPos == storage.getLength();
+  assert((!m_Complete || getFrontier() == m_ScanPos) &&
+         "Text doesn't end with a newline");
+}
+
+// Drops every entry from "count" onwards.
+void LineIndex::truncate(std::size_t count) {
+  if (m_ShiftFrom < count)
+    shift(m_ShiftFrom, count, m_ShiftDelta);
+  if (m_Wide)
+    m_Starts64.resize(count);
+  else
+    m_Starts32.resize(count);
+  m_ShiftFrom = count;
+  m_ShiftDelta = 0;
+}
+
+void LineIndex::setRawStart(std::size_t i, std::size_t start) {
+  if (!m_Wide && start > UINT32_MAX)
+    widen();
+  if (m_Wide) {
+    if (i == m_Starts64.size())
+      m_Starts64.push_back(start);
+    else
+      m_Starts64[i] = start;
+    return;
+  }
+  if (i == m_Starts32.size())
+    m_Starts32.push_back(start);
+  else
+    m_Starts32[i] = start;
+}
+
+// Replaces the "count" entries beginning at "first" with "starts".
+void LineIndex::splice(std::size_t first, std::size_t count,
+                       const std::vector<std::size_t> &starts) {
+  std::size_t n = starts.size();
+  auto resize = [first, count, n](auto &v) {
+    auto I = v.begin() + first;
+    if (n < count)
+      v.erase(I, I + (count - n));
+    else if (n > count)
+      v.insert(I, n - count, 0);
+  };
+  if (m_Wide)
+    resize(m_Starts64);
+  else
+    resize(m_Starts32);
+  for (std::size_t i = 0; i < n; ++i)
+    setRawStart(first + i, starts[i]);
+}
+
+void LineIndex::shift(std::size_t first, std::size_t last,
+                      std::ptrdiff_t delta) {
+  for (std::size_t i = first; i < last; ++i)
+    setRawStart(i, getRawStart(i) + delta);
+}
+
+void LineIndex::widen() {
+  assert(!m_Wide && "LineIndex has already been widened");
+  m_Starts64.assign(m_Starts32.begin(), m_Starts32.end());
+  m_Starts32.clear();
+  m_Starts32.shrink_to_fit();
+  m_Wide = true;
+}
+
+} // namespace jig
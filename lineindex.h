@@ -0,0 +1,116 @@
+//===--- lineindex.h ----------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_LINEINDEX_H__
+#define __JIG_LINEINDEX_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "line.h"
+
+namespace jig {
+
+class Storage;
+
+// Maps between positions in a Storage and the Lines that contain them.
+//
+// Only the position where each Line begins is recorded: a Line ends right
+// before the next one begins, and one extra entry past the last Line holds
+// the total length of the text. The entries are 32 bits wide until the text
+// grows past 4GiB, at which point they are widened to 64 bits.
+//
+// The text is indexed lazily, front to back. Until the index is complete, the
+// last entry is where the first Line that hasn't been found yet begins, and
+// getTotalLines() only counts the Lines that come before it.
+class LineIndex {
+public:
+  LineIndex() = default;
+
+  void reset(const Storage &storage);
+  void update(const Storage &storage, std::size_t pos, std::size_t erased,
+              std::size_t inserted);
+
+  bool isComplete() const { return m_Complete; }
+  std::size_t getScannedLength() const { return m_ScanPos; }
+
+  // Each of these indexes as much more of the text as it needs to, and stops
+  // early if the end of the text is reached first.
+  void indexThroughLine(const Storage &storage, std::size_t lineIndex);
+  void indexThroughPos(const Storage &storage, std::size_t pos);
+  void indexMore(const Storage &storage, std::size_t count);
+  void indexAll(const Storage &storage);
+
+  std::size_t getTotalLines() const { return getTotalStarts() - 1; }
+
+  Line getLine(std::size_t lineIndex) const {
+    return Line{getStart(lineIndex), getStart(lineIndex + 1) - 1};
+  }
+
+  std::size_t getLineLength(std::size_t lineIndex) const {
+    return getStart(lineIndex + 1) - getStart(lineIndex) - 1;
+  }
+
+  std::size_t findLineIndex(std::size_t pos) const;
+
+private:
+  std::size_t getTotalStarts() const {
+    return m_Wide ? m_Starts64.size() : m_Starts32.size();
+  }
+
+  std::size_t getRawStart(std::size_t i) const {
+    return m_Wide ? m_Starts64[i] : m_Starts32[i];
+  }
+
+  std::size_t getStart(std::size_t i) const {
+    std::size_t start = getRawStart(i);
+    return i < m_ShiftFrom ? start : start + m_ShiftDelta;
+  }
+
+  std::size_t getFrontier() const { return getStart(getTotalStarts() - 1); }
+
+  template <typename Done>
+  void scan(const Storage &storage, std::size_t end, Done done);
+  void truncate(std::size_t count);
+
+  void setRawStart(std::size_t i, std::size_t start);
+  void splice(std::size_t first, std::size_t count,
+              const std::vector<std::size_t> &starts);
+  void shift(std::size_t first, std::size_t last, std::ptrdiff_t delta);
+  void widen();
+
+  std::vector<std::uint32_t> m_Starts32;
+  std::vector<std::uint64_t> m_Starts64;
+  bool m_Wide = false;
+
+  // Edits don't move the entries that come after them right away. Instead,
+  // every entry from m_ShiftFrom onwards is stored m_ShiftDelta bytes away
+  // from where its Line really begins, and getStart() corrects for that. The
+  // offset is folded into the stored entries a few at a time as later edits
+  // move past them.
+  std::size_t m_ShiftFrom = 0;
+  std::ptrdiff_t m_ShiftDelta = 0;
+
+  // Everything before m_ScanPos has been searched for newlines. Nothing
+  // between the last entry and m_ScanPos is a newline.
+  std::size_t m_ScanPos = 0;
+  bool m_Complete = false;
+};
+
+} // namespace jig
+
+#endif // __JIG_LINEINDEX_H__
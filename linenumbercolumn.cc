@@ -54,7 +54,7 @@ void LineNumberColumn::updateDimensions() {
   UI &ui = App::getInstance().getUI();
   int titleBarHeight = ui.getTitleBar().getHeight();
   int h = ui.getHeight() - ui.getStatusBar().getHeight() - titleBarHeight;
-  m_Window->resize(h, m_MaxDigits);
+  m_Window->resize(h, m_MaxDigits + 1);
   m_Window->move(titleBarHeight, 0);
   writeToWindow();
 }
@@ -64,13 +64,25 @@ int LineNumberColumn::getKeypress() {
 }
 
 void LineNumberColumn::update() {
-  const Document &doc = App::getInstance().getDocumentList().getCurrent();
-  const Buffer *buffer = doc.getBuffer();
-  m_FirstLineIndex =
-    buffer->getConstLineIterator(doc.getBufferViewData()->offsetY) -
-    buffer->getFirstLineIterator();
-  m_TotalLines = buffer->getTotalLines();
-  m_MaxDigits = getNumberOfDigits(m_TotalLines);
+  auto &app = App::getInstance();
+  const Document &doc = app.getDocumentList().getCurrent();
+  m_Buffer = doc.getBuffer();
+  m_FirstLineIndex = doc.getBufferViewData()->offsetY;
+
+  // Make sure everything that could be on screen has been indexed, but don't
+  // wait for the rest of the Lines to be counted.
+  m_Buffer->hasLine(m_FirstLineIndex + app.getUI().getHeight());
+  int maxDigits = getNumberOfDigits(m_Buffer->getTotalLinesIndexed());
+  if (m_Window && maxDigits != m_MaxDigits) {
+    // More Lines have been counted (or fewer are left) than the column was
+    // made wide enough for, so it and the BufferView beside it are laid out
+    // again.
+    m_MaxDigits = maxDigits;
+    updateDimensions();
+    app.getUI().getBufferView().updateDimensions();
+    return;
+  }
+  m_MaxDigits = maxDigits;
   if (m_Window)
     writeToWindow();
 }
@@ -93,7 +105,7 @@ void LineNumberColumn::writeToWindow() {
 
   std::memset(space, ' ', m_MaxDigits);
   for (int y = 0; y < height; ++y) {
-    if (lineNumber > m_TotalLines) {
+    if (!m_Buffer->hasLine(lineNumber - 1)) {
       m_Window->put(y, 0, space, m_MaxDigits);
       m_Window->put(y, last, *space);
       continue;
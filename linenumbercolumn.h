@@ -17,6 +17,7 @@
 #ifndef __JIG_LINENUMBERCOLUMN_H__
 #define __JIG_LINENUMBERCOLUMN_H__
 
+#include "buffer.h"
 #include "view.h"
 
 namespace jig {
@@ -35,8 +36,8 @@ private:
   void initWindow();
   void writeToWindow();
 
+  const Buffer *m_Buffer = nullptr;
   std::size_t m_FirstLineIndex = 0;
-  std::size_t m_TotalLines = 0;
   int m_MaxDigits = 0;
 };
 
@@ -28,6 +28,8 @@
 namespace jig {
 namespace {
 
+// Messages can come from more than one thread, so each one is written while
+// holding the stream's lock to keep them from being interleaved.
 std::FILE *logPtr = nullptr;
 time::Timer timer;
 
@@ -56,50 +58,60 @@ void Logger::terminate() {
 }
 
 void Logger::info(const char *fmt, ...) {
+  flockfile(logPtr);
   std::fputs("\tINFO: ", logPtr);
   va_list args;
   va_start(args, fmt);
   std::vfprintf(logPtr, fmt, args);
   va_end(args);
   std::fputc('\n', logPtr);
+  funlockfile(logPtr);
 }
 
 void Logger::warn(const char *fmt, ...) {
+  flockfile(logPtr);
   std::fputs("\tWARNING: ", logPtr);
   va_list args;
   va_start(args, fmt);
   std::vfprintf(logPtr, fmt, args);
   va_end(args);
   std::fputc('\n', logPtr);
+  funlockfile(logPtr);
 }
 
 void Logger::error(const char *fmt, ...) {
+  flockfile(logPtr);
   std::fputs("\tERROR: ", logPtr);
   va_list args;
   va_start(args, fmt);
   std::vfprintf(logPtr, fmt, args);
   va_end(args);
   std::fputc('\n', logPtr);
+  funlockfile(logPtr);
 }
 
 void Logger::fatal(const char *fmt, ...) {
+  flockfile(logPtr);
   std::fputs("\tFATAL: ", logPtr);
   va_list args;
   va_start(args, fmt);
   std::vfprintf(logPtr, fmt, args);
   va_end(args);
   std::fputc('\n', logPtr);
+  funlockfile(logPtr);
 }
 
 #ifndef NDEBUG
 void Logger::debug(const char *file, int line, const char *func,
                    const char *fmt, ...) {
+  flockfile(logPtr);
   std::fprintf(logPtr, "\tDEBUG:%s:%d:%s: ", file, line, func);
   va_list args;
   va_start(args, fmt);
   std::vfprintf(logPtr, fmt, args);
   va_end(args);
   std::fputc('\n', logPtr);
+  funlockfile(logPtr);
 }
 #endif
 
@@ -0,0 +1,28 @@
+//===--- mappedfile.cc --------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "mappedfile.h"
+
+#include <sys/mman.h>
+
+namespace jig {
+
+MappedFile::~MappedFile() {
+  if (m_Data)
+    munmap(const_cast<char *>(m_Data), m_Size);
+}
+
+} // namespace jig
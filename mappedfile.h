@@ -0,0 +1,48 @@
+//===--- mappedfile.h ---------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_MAPPEDFILE_H__
+#define __JIG_MAPPEDFILE_H__
+
+#include <cstddef>
+
+namespace jig {
+
+// A read-only mapping of a file's contents into memory. The pages are only
+// read in from the page cache as they're touched, so even a file that is much
+// larger than the available memory can be opened this way.
+//
+// Nothing stops another process from changing or truncating the file while it
+// is mapped, in which case the contents seen here change along with it.
+class MappedFile {
+public:
+  MappedFile(const char *data, std::size_t size) : m_Data{data}, m_Size{size} {}
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *getData() const { return m_Data; }
+  std::size_t getSize() const { return m_Size; }
+
+private:
+  const char *m_Data;
+  std::size_t m_Size;
+};
+
+} // namespace jig
+
+#endif // __JIG_MAPPEDFILE_H__
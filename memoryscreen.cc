@@ -0,0 +1,320 @@
+//===--- memoryscreen.cc ------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "memoryscreen.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Only for the key codes, so that keypresses read the same as they would
+// from a terminal.
+#include <ncurses.h>
+
+namespace jig {
+namespace {
+
+constexpr int TAB_WIDTH = 8;
+
+// "\033[H\033[2J"
+constexpr std::size_t CLEAR_SCREEN_BYTES = 7;
+
+const MemoryScreen::Cell BLANK_CELL{' ', 0};
+
+// "\033[Y;XH"
+std::size_t getCursorMoveBytes(int y, int x) {
+  char seq[32];
+  return std::snprintf(seq, sizeof(seq), "\033[%d;%dH", y + 1, x + 1);
+}
+
+// "\033[0", then ";N" for each attribute, then "m".
+std::size_t getAttrChangeBytes(int attrs) {
+  std::size_t n = 4;
+  for (unsigned int bits = attrs; bits != 0; bits &= bits - 1)
+    n += 2;
+  return n;
+}
+
+} // namespace
+
+// What ncurses does in a WINDOW, kept to what the Views actually use.
+class MemoryScreen::MemorySurface : public Screen::Surface {
+public:
+  MemorySurface(MemoryScreen &screen, int y, int x)
+    : m_Screen{screen},
+      m_StartY{y},
+      m_StartX{x} {}
+
+  virtual void moveCursor(int y, int x) final {
+    if (contains(y, x)) {
+      m_CursorY = y;
+      m_CursorX = x;
+    }
+  }
+
+  virtual void setKeypad(bool enabled) final { m_Keypad = enabled; }
+  virtual void setAttrs(int attrs) final { m_Attrs = attrs; }
+
+  virtual void setBackground(int attrs) final {
+    for (auto &cell : m_Cells)
+      cell.attrs = (cell.attrs & ~m_Background) | attrs;
+    m_Background = attrs;
+  }
+
+  virtual void put(int y, int x, char ch) final { put(y, x, &ch, 1); }
+  virtual void put(int y, int x, const char *str, std::size_t count) final;
+
+  virtual int getKeypress() final { return m_Screen.readKey(m_Keypad); }
+
+  // Replays never wait for input: everything there is to read was given to
+  // the screen up front.
+  virtual void setInputTimeout(int) final {}
+
+  virtual void clear() final {
+    std::fill(m_Cells.begin(), m_Cells.end(), getBlank());
+    m_CursorY = 0;
+    m_CursorX = 0;
+    m_ClearPending = true;
+  }
+
+  virtual void clearToEndOfLine(int y, int x) final {
+    if (!contains(y, x))
+      return;
+    auto row = m_Cells.begin() + y * m_Width;
+    std::fill(row + x, row + m_Width, getBlank());
+    m_CursorY = y;
+    m_CursorX = x;
+  }
+
+  virtual bool move(int y, int x) final {
+    if (y < 0 || x < 0 || y + m_Height > m_Screen.m_Height ||
+        x + m_Width > m_Screen.m_Width)
+      return false;
+    m_StartY = y;
+    m_StartX = x;
+    return true;
+  }
+
+  // Like newwin(), a size of zero reaches to the edge of the screen.
+  virtual bool resize(int h, int w) final {
+    m_Height = h > 0 ? h : m_Screen.m_Height - m_StartY;
+    m_Width = w > 0 ? w : m_Screen.m_Width - m_StartX;
+    if (m_Height <= 0 || m_Width <= 0)
+      return false;
+    m_Cells.assign(m_Height * m_Width, getBlank());
+    m_CursorY = 0;
+    m_CursorX = 0;
+    return true;
+  }
+
+  virtual void refresh() final;
+
+private:
+  bool contains(int y, int x) const {
+    return y >= 0 && x >= 0 && y < m_Height && x < m_Width;
+  }
+
+  Cell getBlank() const { return Cell{' ', m_Background}; }
+  bool addCell(char ch);
+
+  MemoryScreen &m_Screen;
+  std::vector<Cell> m_Cells;
+  int m_Height = 0;
+  int m_Width = 0;
+  int m_StartY;
+  int m_StartX;
+  int m_CursorY = 0;
+  int m_CursorX = 0;
+  int m_Attrs = 0;
+  int m_Background = 0;
+  bool m_Keypad = false;
+  bool m_ClearPending = false;
+};
+
+// Returns false once the bottom right cell has been written, since there's
+// nowhere left for the cursor to go.
+bool MemoryScreen::MemorySurface::addCell(char ch) {
+  if (m_CursorY >= m_Height)
+    return false;
+  m_Cells[m_CursorY * m_Width + m_CursorX] = Cell{ch, m_Attrs | m_Background};
+  if (++m_CursorX < m_Width)
+    return true;
+  if (m_CursorY + 1 == m_Height) {
+    m_CursorX = m_Width - 1;
+    return false;
+  }
+  m_CursorX = 0;
+  ++m_CursorY;
+  return true;
+}
+
+void MemoryScreen::MemorySurface::put(int y, int x, const char *str,
+                                      std::size_t count) {
+  if (!contains(y, x))
+    return;
+  m_CursorY = y;
+  m_CursorX = x;
+  for (std::size_t i = 0; i < count; ++i) {
+    unsigned char c = static_cast<unsigned char>(str[i]);
+    bool more = true;
+    if (c == '\n') {
+      clearToEndOfLine(m_CursorY, m_CursorX);
+      if (m_CursorY + 1 == m_Height)
+        return;
+      ++m_CursorY;
+      m_CursorX = 0;
+    } else if (c == '\t') {
+      do
+        more = addCell(' ');
+      while (more && m_CursorX % TAB_WIDTH != 0);
+    } else if (c < 0x20 || c == 0x7f) {
+      more = addCell('^') && addCell(c == 0x7f ? '?' : c + '@');
+    } else if (c >= 0x80) {
+      more = addCell('?');
+    } else {
+      more = addCell(c);
+    }
+    if (!more)
+      return;
+  }
+}
+
+void MemoryScreen::MemorySurface::refresh() {
+  if (m_ClearPending) {
+    m_Screen.clearShown();
+    m_ClearPending = false;
+  }
+  for (int y = 0; y < m_Height && m_StartY + y < m_Screen.m_Height; ++y) {
+    int n = std::min(m_Width, m_Screen.m_Width - m_StartX);
+    auto from = m_Cells.begin() + y * m_Width;
+    auto to = m_Screen.m_Drawn.begin() +
+              (m_StartY + y) * m_Screen.m_Width + m_StartX;
+    std::copy(from, from + n, to);
+  }
+  m_Screen.flush();
+  m_Screen.moveShownCursor(m_StartY + m_CursorY, m_StartX + m_CursorX);
+}
+
+MemoryScreen::MemoryScreen(int h, int w)
+  : m_Height{h},
+    m_Width{w},
+    m_Drawn(h * w, BLANK_CELL),
+    m_Shown(h * w, BLANK_CELL) {
+  defineKey("\033[A", KEY_UP);
+  defineKey("\033[B", KEY_DOWN);
+  defineKey("\033[C", KEY_RIGHT);
+  defineKey("\033[D", KEY_LEFT);
+  defineKey("\033OA", KEY_UP);
+  defineKey("\033OB", KEY_DOWN);
+  defineKey("\033OC", KEY_RIGHT);
+  defineKey("\033OD", KEY_LEFT);
+  defineKey("\033[3~", KEY_DC);
+  defineKey("\033[Z", KEY_BTAB);
+}
+
+void MemoryScreen::defineKey(const char *seq, int key) {
+  m_Keys.emplace_back(seq, key);
+}
+
+std::unique_ptr<Screen::Surface> MemoryScreen::createSurface(int h, int w,
+                                                             int y, int x) {
+  if (y < 0 || x < 0)
+    return nullptr;
+  auto surface = std::make_unique<MemorySurface>(*this, y, x);
+  if (!surface->resize(h, w))
+    return nullptr;
+  return surface;
+}
+
+void MemoryScreen::addInput(const char *str, std::size_t len) {
+  m_Input.append(str, len);
+}
+
+std::string MemoryScreen::getRow(int y) const {
+  std::string row;
+  row.reserve(m_Width);
+  for (int x = 0; x < m_Width; ++x)
+    row += getCell(y, x).ch;
+  return row;
+}
+
+// With the keypad on, the longest defined sequence at the front of the input
+// is read as one keypress.
+int MemoryScreen::readKey(bool keypad) {
+  if (!hasMoreInput())
+    return NO_KEY;
+  const char *input = m_Input.data() + m_InputPos;
+  std::size_t avail = m_Input.size() - m_InputPos;
+  std::size_t matched = 0;
+  int key = static_cast<unsigned char>(*input);
+  if (keypad) {
+    for (const auto &def : m_Keys) {
+      const std::string &seq = def.first;
+      if (seq.size() > matched && seq.size() <= avail &&
+          std::memcmp(seq.data(), input, seq.size()) == 0) {
+        matched = seq.size();
+        key = def.second;
+      }
+    }
+  }
+  m_InputPos += matched > 0 ? matched : 1;
+  return key;
+}
+
+void MemoryScreen::clearShown() {
+  std::fill(m_Shown.begin(), m_Shown.end(), BLANK_CELL);
+  m_CursorY = 0;
+  m_CursorX = 0;
+  m_ShownAttrs = 0;
+  m_BytesEmitted += CLEAR_SCREEN_BYTES;
+}
+
+void MemoryScreen::moveShownCursor(int y, int x) {
+  if (y == m_CursorY && x == m_CursorX)
+    return;
+  m_BytesEmitted += getCursorMoveBytes(y, x);
+  m_CursorY = y;
+  m_CursorX = x;
+}
+
+// Sends every cell that isn't already showing what was drawn, the way curses
+// would: a cursor move wherever the changes aren't contiguous, and an
+// attribute change wherever the attributes do.
+void MemoryScreen::flush() {
+  for (int y = 0; y < m_Height; ++y) {
+    for (int x = 0; x < m_Width; ++x) {
+      std::size_t i = y * m_Width + x;
+      if (m_Drawn[i] == m_Shown[i])
+        continue;
+      moveShownCursor(y, x);
+      if (m_Drawn[i].attrs != m_ShownAttrs) {
+        m_ShownAttrs = m_Drawn[i].attrs;
+        m_BytesEmitted += getAttrChangeBytes(m_ShownAttrs);
+      }
+      m_Shown[i] = m_Drawn[i];
+      ++m_BytesEmitted;
+      ++m_CellsChanged;
+      if (++m_CursorX == m_Width) {
+        // Where the cursor goes after the last column depends on the
+        // terminal, so always move it explicitly after that.
+        m_CursorY = -1;
+        m_CursorX = -1;
+      }
+    }
+  }
+}
+
+} // namespace jig
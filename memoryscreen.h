@@ -0,0 +1,110 @@
+//===--- memoryscreen.h -------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_MEMORYSCREEN_H__
+#define __JIG_MEMORYSCREEN_H__
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "screen.h"
+
+namespace jig {
+
+// A terminal that only exists in memory, so the UI can run without a TTY.
+// Keypresses come from whatever input it's been given up front, and every
+// refresh is compared against what the "terminal" already shows to count what
+// would have had to be sent to a real one.
+class MemoryScreen : public Screen {
+public:
+  struct Cell {
+    char ch;
+    int attrs;
+
+    bool operator==(const Cell &other) const {
+      return ch == other.ch && attrs == other.attrs;
+    }
+    bool operator!=(const Cell &other) const { return !(*this == other); }
+  };
+
+  MemoryScreen(int h, int w);
+
+  virtual Type getType() const final { return Type::MEMORY; }
+
+  virtual bool start() final { return true; }
+  virtual void stop() final {}
+
+  // Its size never changes.
+  virtual void reset() final {}
+
+  virtual int getHeight() const final { return m_Height; }
+  virtual int getWidth() const final { return m_Width; }
+
+  virtual void defineKey(const char *seq, int key) final;
+
+  virtual bool hasMoreInput() const final {
+    return m_InputPos < m_Input.size();
+  }
+
+  virtual std::unique_ptr<Surface> createSurface(int h, int w, int y,
+                                                 int x) final;
+  virtual void refresh() final { flush(); }
+
+  void addInput(const char *str, std::size_t len);
+
+  // What the terminal shows. Anything that isn't printable ASCII is shown as
+  // '?', and control characters as "^X" the way ncurses draws them.
+  const Cell &getCell(int y, int x) const { return m_Shown[y * m_Width + x]; }
+  std::string getRow(int y) const;
+  int getCursorY() const { return m_CursorY; }
+  int getCursorX() const { return m_CursorX; }
+
+  // Cells that had to be redrawn, and about how many bytes of escape
+  // sequences and text that would have taken, since the screen was created.
+  std::uint64_t getCellsChanged() const { return m_CellsChanged; }
+  std::uint64_t getBytesEmitted() const { return m_BytesEmitted; }
+
+private:
+  class MemorySurface;
+
+  int readKey(bool keypad);
+  void clearShown();
+  void moveShownCursor(int y, int x);
+  void flush();
+
+  int m_Height;
+  int m_Width;
+
+  // Everything Surfaces have refreshed so far, and what was last "sent".
+  std::vector<Cell> m_Drawn;
+  std::vector<Cell> m_Shown;
+  int m_CursorY = 0;
+  int m_CursorX = 0;
+  int m_ShownAttrs = 0;
+
+  std::string m_Input;
+  std::size_t m_InputPos = 0;
+  std::vector<std::pair<std::string, int>> m_Keys;
+
+  std::uint64_t m_CellsChanged = UINT64_C(0);
+  std::uint64_t m_BytesEmitted = UINT64_C(0);
+};
+
+} // namespace jig
+
+#endif // __JIG_MEMORYSCREEN_H__
@@ -0,0 +1,277 @@
+//===--- piecetable.cc --------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "piecetable.h"
+
+#include <assert.h>
+#include <cstring>
+
+namespace jig {
+namespace {
+
+constexpr std::size_t ADD_BLOCK_SIZE = 65536;
+
+} // namespace
+
+struct PieceTable::Blocks {
+  // The original block is either owned outright or mapped in from a file.
+  std::string original;
+  std::unique_ptr<MappedFile> mappedOriginal;
+
+  // The add block is allocated in fixed-size pieces that never move once
+  // they've been handed out, so pieces can safely point straight into them.
+  // Only the PieceTable itself ever looks at this vector. Snapshots only
+  // read the bytes it owns, none of which change once they're in a piece.
+  std::vector<std::unique_ptr<char[]>> add;
+};
+
+struct PieceTable::Node {
+  Node(const char *d, std::size_t l, std::uint32_t p)
+    : data{d}, length{l}, subtreeLength{l}, subtreePieces{1}, priority{p} {}
+
+  static std::size_t lengthOf(const NodePtr &node) {
+    return node ? node->subtreeLength : 0;
+  }
+
+  static std::size_t piecesOf(const NodePtr &node) {
+    return node ? node->subtreePieces : 0;
+  }
+
+  void update() {
+    subtreeLength = lengthOf(left) + length + lengthOf(right);
+    subtreePieces = piecesOf(left) + 1 + piecesOf(right);
+  }
+
+  const char *data;
+  std::size_t length;
+  std::size_t subtreeLength;
+  std::size_t subtreePieces;
+  std::uint32_t priority;
+  NodePtr left = nullptr;
+  NodePtr right = nullptr;
+};
+
+class PieceTable::TreeSnapshot : public Storage::Snapshot {
+public:
+  TreeSnapshot(NodePtr root, std::shared_ptr<Blocks> blocks)
+      : m_Root{std::move(root)}, m_Blocks{std::move(blocks)} {}
+
+  virtual std::size_t getLength() const final {
+    return Node::lengthOf(m_Root);
+  }
+
+  virtual Chunk getChunkAt(std::size_t pos) const final {
+    assert(pos < getLength() && "Position is out of bounds");
+    return findChunk(m_Root.get(), pos);
+  }
+
+private:
+  NodePtr m_Root;
+  std::shared_ptr<Blocks> m_Blocks;
+};
+
+PieceTable::PieceTable(std::string original)
+    : m_Blocks{std::make_shared<Blocks>()} {
+  m_Blocks->original = std::move(original);
+  const std::string &str = m_Blocks->original;
+  if (!str.empty())
+    m_Root = makeNode(str.data(), str.size());
+}
+
+PieceTable::PieceTable(std::unique_ptr<MappedFile> original)
+    : m_Blocks{std::make_shared<Blocks>()} {
+  m_Blocks->mappedOriginal = std::move(original);
+  const MappedFile &mapping = *m_Blocks->mappedOriginal;
+  if (mapping.getSize() != 0)
+    m_Root = makeNode(mapping.getData(), mapping.getSize());
+}
+
+PieceTable::~PieceTable() = default;
+
+std::size_t PieceTable::getLength() const {
+  return Node::lengthOf(m_Root);
+}
+
+char PieceTable::getCharAt(std::size_t pos) const {
+  Chunk chunk = getChunkAt(pos);
+  return chunk.data[pos - chunk.pos];
+}
+
+Storage::Chunk PieceTable::getChunkAt(std::size_t pos) const {
+  assert(pos < getLength() && "Position is out of bounds");
+  return findChunk(m_Root.get(), pos);
+}
+
+std::unique_ptr<Storage::Snapshot> PieceTable::getSnapshot() const {
+  return std::make_unique<TreeSnapshot>(m_Root, m_Blocks);
+}
+
+Storage::Chunk PieceTable::findChunk(const Node *node, std::size_t pos) {
+  std::size_t base = 0;
+  while (node) {
+    std::size_t leftLen = Node::lengthOf(node->left);
+    if (pos < leftLen) {
+      node = node->left.get();
+      continue;
+    }
+    pos -= leftLen;
+    base += leftLen;
+    if (pos < node->length)
+      return Chunk{node->data, node->length, base};
+    pos -= node->length;
+    base += node->length;
+    node = node->right.get();
+  }
+  return Chunk{nullptr, 0, base}; // This should never be reached.
+}
+
+void PieceTable::insert(std::size_t pos, const char *str, std::size_t len) {
+  assert(pos <= getLength() && "Position is out of bounds");
+  if (len == 0)
+    return;
+
+  const char *data = append(str, len);
+
+  NodePtr left, right;
+  split(std::move(m_Root), pos, left, right);
+
+  // When typing, every new character lands right after the previous one in
+  // both the text and the add block. Rather than adding a new piece for each
+  // of them, grow the piece that ends where this insertion begins.
+  const Node *last = left.get();
+  while (last && last->right)
+    last = last->right.get();
+  if (last && last->data + last->length == data) {
+    for (NodePtr *link = &left; *link; link = &(*link)->right) {
+      Node *node = own(*link);
+      node->subtreeLength += len;
+      if (!node->right)
+        node->length += len;
+    }
+    m_Root = merge(std::move(left), std::move(right));
+    return;
+  }
+
+  m_Root = merge(merge(std::move(left), makeNode(data, len)), std::move(right));
+}
+
+void PieceTable::erase(std::size_t pos, std::size_t count) {
+  std::size_t len = getLength();
+  assert(pos <= len && "Position is out of bounds");
+  if (count > len - pos)
+    count = len - pos;
+  if (count == 0)
+    return;
+
+  NodePtr left, middle, right;
+  split(std::move(m_Root), pos, left, right);
+  split(std::move(right), count, middle, right);
+  m_Root = merge(std::move(left), std::move(right));
+}
+
+std::size_t PieceTable::getTotalPieces() const {
+  return Node::piecesOf(m_Root);
+}
+
+// Makes sure "node" can be changed without a Snapshot seeing the change, by
+// swapping it for a copy of itself if anything else still refers to it. The
+// copy shares the original's children, so they in turn end up being copied
+// if a change reaches them too.
+PieceTable::Node *PieceTable::own(NodePtr &node) {
+  if (node.use_count() > 1)
+    node = std::make_shared<Node>(*node);
+  return node.get();
+}
+
+PieceTable::NodePtr PieceTable::merge(NodePtr left, NodePtr right) {
+  if (!left)
+    return right;
+  if (!right)
+    return left;
+  if (left->priority > right->priority) {
+    Node *node = own(left);
+    node->right = merge(std::move(node->right), std::move(right));
+    node->update();
+    return left;
+  }
+  Node *node = own(right);
+  node->left = merge(std::move(left), std::move(node->left));
+  node->update();
+  return right;
+}
+
+// Splits the tree rooted at "node" so that "left" holds the first "pos" bytes
+// of its text and "right" holds the rest. A piece that straddles "pos" is cut
+// in two.
+void PieceTable::split(NodePtr node, std::size_t pos, NodePtr &left,
+                       NodePtr &right) {
+  if (!node) {
+    left = nullptr;
+    right = nullptr;
+    return;
+  }
+
+  Node *n = own(node);
+  std::size_t leftLen = Node::lengthOf(n->left);
+
+  if (pos <= leftLen) {
+    split(std::move(n->left), pos, left, n->left);
+    n->update();
+    right = std::move(node);
+    return;
+  }
+
+  if (pos >= leftLen + n->length) {
+    split(std::move(n->right), pos - leftLen - n->length, n->right, right);
+    n->update();
+    left = std::move(node);
+    return;
+  }
+
+  std::size_t off = pos - leftLen;
+  NodePtr tail = makeNode(n->data + off, n->length - off);
+  right = merge(std::move(tail), std::move(n->right));
+  n->length = off;
+  n->update();
+  left = std::move(node);
+}
+
+PieceTable::NodePtr PieceTable::makeNode(const char *data, std::size_t length) {
+  return std::make_shared<Node>(data, length, nextPriority());
+}
+
+const char *PieceTable::append(const char *str, std::size_t len) {
+  auto &blocks = m_Blocks->add;
+  if (blocks.empty() || m_AddBlockUsed + len > m_AddBlockSize) {
+    m_AddBlockSize = len > ADD_BLOCK_SIZE ? len : ADD_BLOCK_SIZE;
+    blocks.emplace_back(new char[m_AddBlockSize]);
+    m_AddBlockUsed = 0;
+  }
+  char *data = blocks.back().get() + m_AddBlockUsed;
+  std::memcpy(data, str, len);
+  m_AddBlockUsed += len;
+  return data;
+}
+
+std::uint32_t PieceTable::nextPriority() {
+  // xorshift32
+  m_Seed ^= m_Seed << 13;
+  m_Seed ^= m_Seed >> 17;
+  m_Seed ^= m_Seed << 5;
+  return m_Seed;
+}
+
+} // namespace jig
@@ -0,0 +1,90 @@
+//===--- piecetable.h ---------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_PIECETABLE_H__
+#define __JIG_PIECETABLE_H__
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "mappedfile.h"
+#include "storage.h"
+
+namespace jig {
+
+// A piece table keeps the original text in a read-only block that is never
+// modified, and everything that gets inserted afterwards in an append-only
+// "add" block. The text itself is described by an ordered sequence of pieces,
+// each of which points at a span of one of those two blocks.
+//
+// The pieces are kept in a treap ordered by their position in the text. Each
+// node knows the total length of its subtree, so finding, splitting and
+// joining pieces at any position takes O(log n) time in the number of pieces
+// no matter how large the text is.
+//
+// Nodes are shared with Snapshots rather than copied, and a node is only
+// copied when it is about to be changed while a Snapshot still refers to it.
+// Taking a Snapshot is therefore O(1), and an edit made afterwards copies at
+// most the O(log n) nodes along the paths it changes.
+class PieceTable : public Storage {
+public:
+  PieceTable(std::string original);
+  PieceTable(std::unique_ptr<MappedFile> original);
+  ~PieceTable();
+
+  virtual Type getType() const final { return Type::PIECE_TABLE; }
+  virtual std::size_t getLength() const final;
+
+  virtual char getCharAt(std::size_t pos) const final;
+  virtual Chunk getChunkAt(std::size_t pos) const final;
+
+  virtual std::unique_ptr<Snapshot> getSnapshot() const final;
+
+  virtual void insert(std::size_t pos, const char *str, std::size_t len) final;
+  virtual void erase(std::size_t pos, std::size_t count) final;
+
+  std::size_t getTotalPieces() const;
+
+private:
+  struct Node;
+  struct Blocks;
+  class TreeSnapshot;
+  using NodePtr = std::shared_ptr<Node>;
+
+  static Chunk findChunk(const Node *node, std::size_t pos);
+  static Node *own(NodePtr &node);
+  static NodePtr merge(NodePtr left, NodePtr right);
+  void split(NodePtr node, std::size_t pos, NodePtr &left, NodePtr &right);
+
+  NodePtr makeNode(const char *data, std::size_t length);
+  const char *append(const char *str, std::size_t len);
+
+  std::uint32_t nextPriority();
+
+  // Everything the pieces point into. Snapshots share ownership of it, so it
+  // outlives this PieceTable for as long as any of them need it.
+  std::shared_ptr<Blocks> m_Blocks;
+  std::size_t m_AddBlockUsed = 0;
+  std::size_t m_AddBlockSize = 0;
+
+  NodePtr m_Root;
+  std::uint32_t m_Seed = 2463534242U;
+};
+
+} // namespace jig
+
+#endif // __JIG_PIECETABLE_H__
@@ -0,0 +1,332 @@
+//===--- recoverylog.cc -------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "recoverylog.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "logger.h"
+#include "mappedfile.h"
+#include "strutils.h"
+#include "system.h"
+
+namespace jig {
+namespace {
+
+constexpr char MAGIC[8] = {'j', 'i', 'g', 'w', 'a', 'l', '0', '1'};
+
+constexpr char LOG_EXTENSION[] = ".log";
+constexpr char TEMP_EXTENSION[] = ".tmp";
+
+bool writeAll(int fd, const void *data, std::size_t size) {
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+} // namespace
+
+RecoveryLog::RecoveryLog(const Path &filePath, long flushMillis)
+    : m_Path{(System::getRecoveryDirectory() + System::getStateName(filePath))
+               .getString() +
+             LOG_EXTENSION},
+      m_FlushMillis{flushMillis} {}
+
+RecoveryLog::~RecoveryLog() {
+  close();
+  if (m_Fd != -1)
+    ::close(m_Fd);
+}
+
+// The Header is checked against the text's length before anything else, so
+// that a log for a file that has obviously changed is never read, and the text
+// is only hashed when the log could still be for it. The records are read
+// straight out of a mapping of the log.
+bool RecoveryLog::readOld(const Buffer &buffer, std::vector<Change> &changes,
+                          std::string &text) {
+  int fd = ::open(m_Path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return false;
+  Header header;
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      pread(fd, &header, sizeof(header), 0) !=
+        static_cast<ssize_t>(sizeof(header)) ||
+      std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    ::close(fd);
+    return false;
+  }
+  if (header.contentLength != buffer.getLength()) {
+    ::close(fd);
+    Logger::info("ignoring recovery log `%s' -- the file has changed since",
+                 m_Path.c_str());
+    return false;
+  }
+
+  std::size_t size = st.st_size;
+  void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    Logger::warn("failed to read recovery log `%s' -- %s", m_Path.c_str(),
+                 std::strerror(errno));
+    return false;
+  }
+  MappedFile mapping{static_cast<const char *>(data), size};
+
+  if (header.contentHash != buffer.getHash()) {
+    Logger::info("ignoring recovery log `%s' -- the file has changed since",
+                 m_Path.c_str());
+    return false;
+  }
+
+  // Whatever was cut short by the crash is left out.
+  changes.clear();
+  text.clear();
+  const char *contents = mapping.getData();
+  std::size_t offset = sizeof(header);
+  while (size - offset >= sizeof(Record)) {
+    Record record;
+    std::memcpy(&record, contents + offset, sizeof(record));
+    offset += sizeof(record);
+    Change change{record.type, record.pos, record.length, text.size()};
+    if (record.type == Record::Type::INSERT) {
+      if (size - offset < record.length)
+        break;
+      text.append(contents + offset, record.length);
+      offset += record.length;
+    } else if (record.type != Record::Type::ERASE) {
+      break;
+    }
+    changes.push_back(change);
+  }
+  return true;
+}
+
+void RecoveryLog::logInsert(const Buffer &buffer, std::size_t pos,
+                            const char *str, std::size_t len) {
+  if (!m_Started)
+    start(buffer);
+  append(Record{Record::Type::INSERT, pos, len}, str);
+}
+
+void RecoveryLog::logErase(const Buffer &buffer, std::size_t pos,
+                           std::size_t count) {
+  if (!m_Started)
+    start(buffer);
+  append(Record{Record::Type::ERASE, pos, count}, nullptr);
+}
+
+void RecoveryLog::beginSave() {
+  std::lock_guard<std::mutex> lock{m_Mutex};
+  m_Saving = true;
+  m_SinceSave.clear();
+}
+
+void RecoveryLog::endSave(bool succeeded, bool clean,
+                          std::uint64_t contentLength,
+                          std::uint64_t contentHash) {
+  if (!m_Saving)
+    return;
+  m_Saving = false;
+  if (succeeded && clean) {
+    discard();
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock{m_Mutex};
+  if (succeeded && m_Started) {
+    // Start over against what was saved, with only what changed since.
+    m_Reset = Reset::START;
+    m_Base.reset();
+    m_BaseLength = contentLength;
+    m_BaseHash = contentHash;
+    m_Pending = std::move(m_SinceSave);
+    m_WakeUp.notify_one();
+  }
+  m_SinceSave.clear();
+}
+
+void RecoveryLog::discard() {
+  m_Started = false;
+  if (!m_Thread.joinable()) {
+    unlink(m_Path.c_str());
+    return;
+  }
+  std::lock_guard<std::mutex> lock{m_Mutex};
+  m_Reset = Reset::DISCARD;
+  m_Base.reset();
+  m_Pending.clear();
+  m_SinceSave.clear();
+  m_WakeUp.notify_one();
+}
+
+void RecoveryLog::close() {
+  if (!m_Thread.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock{m_Mutex};
+    m_Stopping = true;
+    m_WakeUp.notify_one();
+  }
+  m_Thread.join();
+}
+
+void RecoveryLog::start(const Buffer &buffer) {
+  m_Started = true;
+  {
+    std::lock_guard<std::mutex> lock{m_Mutex};
+    m_Reset = Reset::START;
+    m_Base = buffer.getSnapshot();
+    m_Pending.clear();
+    m_WakeUp.notify_one();
+  }
+  if (!m_Thread.joinable())
+    m_Thread = std::thread{&RecoveryLog::run, this};
+}
+
+void RecoveryLog::append(const Record &record, const char *text) {
+  std::lock_guard<std::mutex> lock{m_Mutex};
+  // The thread only needs waking when there was nothing for it to do.
+  if (m_Pending.empty() && m_Reset == Reset::NONE)
+    m_WakeUp.notify_one();
+  const char *data = reinterpret_cast<const char *>(&record);
+  m_Pending.append(data, sizeof(record));
+  if (text)
+    m_Pending.append(text, record.length);
+  if (m_Saving) {
+    m_SinceSave.append(data, sizeof(record));
+    if (text)
+      m_SinceSave.append(text, record.length);
+  }
+}
+
+void RecoveryLog::run() {
+  std::unique_lock<std::mutex> lock{m_Mutex};
+  while (!m_Stopping) {
+    m_WakeUp.wait(lock, [this] {
+      return m_Stopping || m_Reset != Reset::NONE || !m_Pending.empty();
+    });
+    // Let more changes pile up, so that they're all synced together.
+    m_WakeUp.wait_for(lock, std::chrono::milliseconds{m_FlushMillis},
+                      [this] { return m_Stopping; });
+    flush(lock);
+  }
+  flush(lock);
+}
+
+void RecoveryLog::flush(std::unique_lock<std::mutex> &lock) {
+  Reset reset = m_Reset;
+  m_Reset = Reset::NONE;
+  std::unique_ptr<Buffer::Snapshot> base{std::move(m_Base)};
+  std::uint64_t baseLength = m_BaseLength;
+  std::uint64_t baseHash = m_BaseHash;
+  std::string records;
+  records.swap(m_Pending);
+  lock.unlock();
+
+  switch (reset) {
+    case Reset::DISCARD:
+      if (m_Fd != -1) {
+        ::close(m_Fd);
+        m_Fd = -1;
+      }
+      if (unlink(m_Path.c_str()) != 0 && errno != ENOENT)
+        Logger::warn("failed to remove recovery log `%s' -- %s",
+                     m_Path.c_str(), std::strerror(errno));
+      break;
+    case Reset::START:
+      if (base) {
+        baseLength = base->getLength();
+        baseHash = str::HASH_SEED;
+        for (auto it = base->getChunks(0, baseLength); it.isValid(); ++it)
+          baseHash = str::hash((*it).data(), (*it).size(), baseHash);
+        base.reset();
+      }
+      rewrite(baseLength, baseHash, records);
+      break;
+    default:
+      if (!records.empty())
+        appendToFile(records);
+      break;
+  }
+
+  lock.lock();
+}
+
+// The new log is written next to the old one and then put in its place, so
+// that there's always one whole log to recover from.
+bool RecoveryLog::rewrite(std::uint64_t contentLength,
+                          std::uint64_t contentHash,
+                          const std::string &records) {
+  if (m_Fd != -1) {
+    ::close(m_Fd);
+    m_Fd = -1;
+  }
+
+  std::string tempPath = m_Path + TEMP_EXTENSION;
+  int fd = ::open(tempPath.c_str(),
+                  O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                  S_IRUSR | S_IWUSR);
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.contentLength = contentLength;
+  header.contentHash = contentHash;
+  if (fd == -1 || !writeAll(fd, &header, sizeof(header)) ||
+      !writeAll(fd, records.data(), records.size()) || fdatasync(fd) != 0 ||
+      rename(tempPath.c_str(), m_Path.c_str()) != 0) {
+    Logger::warn("failed to write recovery log `%s' -- %s", m_Path.c_str(),
+                 std::strerror(errno));
+    if (fd != -1) {
+      ::close(fd);
+      unlink(tempPath.c_str());
+    }
+    return false;
+  }
+  m_Fd = fd;
+  return true;
+}
+
+bool RecoveryLog::appendToFile(const std::string &records) {
+  // If the log couldn't be started, there's nothing to add to.
+  if (m_Fd == -1)
+    return false;
+  if (!writeAll(m_Fd, records.data(), records.size()) ||
+      fdatasync(m_Fd) != 0) {
+    Logger::warn("failed to write recovery log `%s' -- %s", m_Path.c_str(),
+                 std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+} // namespace jig
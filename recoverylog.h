@@ -0,0 +1,138 @@
+//===--- recoverylog.h --------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_RECOVERYLOG_H__
+#define __JIG_RECOVERYLOG_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "path.h"
+
+namespace jig {
+
+// A write-ahead log of the changes made to a file's text since it was last
+// saved, so they can be recovered if jig dies before it's saved again. The
+// log is a file in the recovery directory, named after the file's real path.
+// It starts with a Header that says what the file held when the log began,
+// followed by a Record for each change.
+//
+// Logging a change only copies it into memory. A thread of the log's own
+// writes everything logged since the last time it woke up and syncs it, no
+// more than once every "flushMillis", so a crash loses at most that much.
+class RecoveryLog {
+public:
+  struct Header {
+    char magic[8];
+    std::uint64_t contentLength;
+    std::uint64_t contentHash;
+  };
+
+  // An INSERT is followed by "length" bytes of inserted text.
+  struct Record {
+    enum class Type : std::uint64_t { INSERT, ERASE };
+
+    Type type;
+    std::uint64_t pos;
+    std::uint64_t length;
+  };
+
+  // A change read back from an old log. An INSERT's text is at "textOffset"
+  // in the text read along with it.
+  struct Change {
+    Record::Type type;
+    std::size_t pos;
+    std::size_t length;
+    std::size_t textOffset;
+  };
+
+  RecoveryLog(const Path &filePath, long flushMillis);
+  ~RecoveryLog();
+
+  RecoveryLog(const RecoveryLog &) = delete;
+  RecoveryLog &operator=(const RecoveryLog &) = delete;
+
+  // Reads the log left behind by an earlier run, as long as it was written
+  // against the text "buffer" holds now.
+  bool readOld(const Buffer &buffer, std::vector<Change> &changes,
+               std::string &text);
+
+  // Called by a Buffer before each change to its text. The first change
+  // starts a new log against the text as it was before it.
+  void logInsert(const Buffer &buffer, std::size_t pos, const char *str,
+                 std::size_t len);
+  void logErase(const Buffer &buffer, std::size_t pos, std::size_t count);
+
+  // A save that starts after the log does becomes what the log is written
+  // against once it's done, and the log only has to hold what changed after
+  // it started. "clean" is whether nothing has changed since.
+  void beginSave();
+  void endSave(bool succeeded, bool clean, std::uint64_t contentLength,
+               std::uint64_t contentHash);
+
+  // Removes the log. Nothing needs recovering.
+  void discard();
+
+  // Writes out whatever is left and stops the thread.
+  void close();
+
+private:
+  enum class Reset {
+    NONE,
+    DISCARD,
+    START,
+  };
+
+  void start(const Buffer &buffer);
+  void append(const Record &record, const char *text);
+  void run();
+  void flush(std::unique_lock<std::mutex> &lock);
+  bool rewrite(std::uint64_t contentLength, std::uint64_t contentHash,
+               const std::string &records);
+  bool appendToFile(const std::string &records);
+
+  std::string m_Path;
+  long m_FlushMillis;
+  int m_Fd = -1;
+
+  // Only touched by the thread that makes the changes.
+  bool m_Started = false;
+  bool m_Saving = false;
+
+  // Everything below is shared with the flushing thread. A Reset replaces
+  // the whole file: DISCARD removes it, and START writes it anew from a
+  // Header and m_Pending.
+  std::mutex m_Mutex;
+  std::condition_variable m_WakeUp;
+  Reset m_Reset = Reset::NONE;
+  std::unique_ptr<Buffer::Snapshot> m_Base;
+  std::uint64_t m_BaseLength = 0;
+  std::uint64_t m_BaseHash = 0;
+  std::string m_Pending;
+  std::string m_SinceSave;
+  bool m_Stopping = false;
+  std::thread m_Thread;
+};
+
+} // namespace jig
+
+#endif // __JIG_RECOVERYLOG_H__
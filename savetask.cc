@@ -0,0 +1,86 @@
+//===--- savetask.cc ----------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "savetask.h"
+
+#include "file.h"
+#include "logger.h"
+#include "strutils.h"
+#include "timeutils.h"
+
+namespace jig {
+
+SaveTask::SaveTask(const Path &path,
+                   std::unique_ptr<Buffer::Snapshot> snapshot,
+                   std::unique_ptr<UndoJournal::Checkpoint> checkpoint)
+    : m_Path{path}, m_Snapshot{std::move(snapshot)},
+      m_Checkpoint{std::move(checkpoint)},
+      m_Version{m_Snapshot->getVersion()} {
+  m_Thread = std::thread{&SaveTask::run, this};
+}
+
+SaveTask::~SaveTask() {
+  wait();
+}
+
+void SaveTask::wait() {
+  if (m_Thread.joinable())
+    m_Thread.join();
+}
+
+void SaveTask::run() {
+  time::Timer timer;
+  timer.start();
+
+  // This thread gets a File object of its own, so nothing it does can be
+  // seen by the one the Document keeps until the save is over.
+  File file{m_Path};
+  file.beginAtomicWrite();
+  std::size_t len = m_Snapshot->getLength();
+  std::uint64_t hash = str::HASH_SEED;
+  for (auto it = m_Snapshot->getChunks(0, len);
+       it.isValid() && !file.hadError(); ++it) {
+    StringRef span = *it;
+    file.write(span.data(), span.size());
+    hash = str::hash(span.data(), span.size(), hash);
+  }
+  m_Length = len;
+  m_ContentHash = hash;
+  file.commitAtomicWrite();
+
+  // The Snapshot keeps the text it was taken from alive, so let go of it as
+  // soon as it isn't needed.
+  m_Snapshot.reset();
+
+  timer.stop();
+  if (file.hadError()) {
+    m_ErrorMessage = file.errorMessage();
+    m_State.store(State::FAILED, std::memory_order_release);
+    return;
+  }
+  Logger::info("saved %zu bytes to `%s' in %ldms", len, m_Path.getCString(),
+               timer.getElapsedMillis());
+
+  if (m_Checkpoint) {
+    m_Checkpoint->header.contentLength = len;
+    m_Checkpoint->header.contentHash = hash;
+    m_WroteCheckpoint = m_Checkpoint->journal->write(*m_Checkpoint);
+    m_Checkpoint.reset();
+  }
+  m_State.store(State::SUCCEEDED, std::memory_order_release);
+}
+
+} // namespace jig
@@ -0,0 +1,86 @@
+//===--- savetask.h -----------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_SAVETASK_H__
+#define __JIG_SAVETASK_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "buffer.h"
+#include "path.h"
+#include "undojournal.h"
+
+namespace jig {
+
+// Writes a Snapshot of a Buffer out to a file on a thread of its own, so that
+// editing can carry on while a large file is being saved. The undo history
+// that leads up to the Snapshot can be checkpointed along with it.
+class SaveTask {
+public:
+  enum class State {
+    RUNNING,
+    SUCCEEDED,
+    FAILED,
+  };
+
+  SaveTask(const Path &path, std::unique_ptr<Buffer::Snapshot> snapshot,
+           std::unique_ptr<UndoJournal::Checkpoint> checkpoint = nullptr);
+  ~SaveTask();
+
+  SaveTask(const SaveTask &) = delete;
+  SaveTask &operator=(const SaveTask &) = delete;
+
+  State getState() const { return m_State.load(std::memory_order_acquire); }
+  bool isRunning() const { return getState() == State::RUNNING; }
+
+  // The version of the Buffer the Snapshot was taken from.
+  std::uint64_t getVersion() const { return m_Version; }
+
+  // The length and str::hash() of the text that was saved.
+  std::uint64_t getLength() const { return m_Length; }
+  std::uint64_t getContentHash() const { return m_ContentHash; }
+
+  // Only meaningful once the task is over. The checkpoint is only written if
+  // the file was saved.
+  bool didWriteCheckpoint() const { return m_WroteCheckpoint; }
+
+  // Only meaningful once the State is FAILED.
+  const std::string &getErrorMessage() const { return m_ErrorMessage; }
+
+  void wait();
+
+private:
+  void run();
+
+  Path m_Path;
+  std::unique_ptr<Buffer::Snapshot> m_Snapshot;
+  std::unique_ptr<UndoJournal::Checkpoint> m_Checkpoint;
+  bool m_WroteCheckpoint = false;
+  std::uint64_t m_Version;
+  std::uint64_t m_Length = 0;
+  std::uint64_t m_ContentHash = 0;
+  std::string m_ErrorMessage;
+  std::atomic<State> m_State{State::RUNNING};
+  std::thread m_Thread;
+};
+
+} // namespace jig
+
+#endif // __JIG_SAVETASK_H__
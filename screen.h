@@ -0,0 +1,91 @@
+//===--- screen.h -------------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_SCREEN_H__
+#define __JIG_SCREEN_H__
+
+#include <cstddef>
+#include <memory>
+
+namespace jig {
+
+// Where the UI gets drawn. Every Window draws onto a Surface the Screen gives
+// it, so the same Views can run on a real terminal or on one that only exists
+// in memory.
+class Screen {
+public:
+  enum class Type {
+    TERMINAL,
+    MEMORY,
+  };
+
+  // What getKeypress() returns when there's no input. It's the same value
+  // ncurses uses for this.
+  static constexpr int NO_KEY = -1;
+
+  // A rectangle of cells belonging to one Window. Nothing written to it shows
+  // up on the Screen until it's refreshed.
+  class Surface {
+  public:
+    virtual ~Surface() {}
+
+    virtual void moveCursor(int y, int x) = 0;
+    virtual void setKeypad(bool enabled) = 0;
+
+    // "attrs" replaces whatever attributes were being written with before.
+    virtual void setAttrs(int attrs) = 0;
+    virtual void setBackground(int attrs) = 0;
+
+    virtual void put(int y, int x, char ch) = 0;
+    virtual void put(int y, int x, const char *str, std::size_t count) = 0;
+
+    virtual int getKeypress() = 0;
+    virtual void setInputTimeout(int millis) = 0;
+
+    virtual void clear() = 0;
+    virtual void clearToEndOfLine(int y, int x) = 0;
+    virtual bool move(int y, int x) = 0;
+    virtual bool resize(int h, int w) = 0;
+    virtual void refresh() = 0;
+  };
+
+  virtual ~Screen() {}
+
+  virtual Type getType() const = 0;
+
+  virtual bool start() = 0;
+  virtual void stop() = 0;
+
+  // Starts over with the screen's new size after it's been resized.
+  virtual void reset() = 0;
+
+  virtual int getHeight() const = 0;
+  virtual int getWidth() const = 0;
+
+  // Makes "seq" read as the single keypress "key".
+  virtual void defineKey(const char *seq, int key) = 0;
+
+  // Whether getKeypress() could still return anything but NO_KEY.
+  virtual bool hasMoreInput() const = 0;
+
+  virtual std::unique_ptr<Surface> createSurface(int h, int w, int y,
+                                                 int x) = 0;
+  virtual void refresh() = 0;
+};
+
+} // namespace jig
+
+#endif // __JIG_SCREEN_H__
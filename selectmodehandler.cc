@@ -49,9 +49,7 @@ std::size_t SelectModeHandler::getLength() const {
 
 std::string SelectModeHandler::getText(const Document &doc) const {
   auto p = maybeSwap(m_Head, m_Tail);
-  auto text =
-    doc.getBuffer()->getStrBuf().substr(p.first, (p.second - p.first) + 1);
-  return text;
+  return doc.getBuffer()->getStringAt(p.first, (p.second - p.first) + 1);
 }
 
 void SelectModeHandler::eraseText(Document &doc) {
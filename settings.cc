@@ -17,7 +17,7 @@
 #include "settings.h"
 
 #include <cctype>
-#include <cstdlib>
+#include <climits>
 
 #include "logger.h"
 #include "strutils.h"
@@ -25,14 +25,14 @@
 namespace jig {
 namespace {
 
-bool isBooleanString(const std::string &value) {
+bool isBooleanString(StringRef value) {
   return str::areEqualIgnoreCase(value, "true") ||
          str::areEqualIgnoreCase(value, "false");
 }
 
-bool isNumberString(const std::string &value) {
+bool isNumberString(StringRef value) {
   for (const auto &c : value)
-    if (!std::isdigit(c))
+    if (!std::isdigit(static_cast<unsigned char>(c)))
       return false;
   return true;
 }
@@ -58,7 +58,7 @@ Settings::Value &Settings::Value::operator=(const char *value) {
 }
 
 Settings::ValueType
-Settings::getRealValueTypeForValueAsString(const std::string &value) {
+Settings::getRealValueTypeForValueAsString(StringRef value) {
   if (isBooleanString(value))
     return ValueType::BOOLEAN;
   if (isNumberString(value))
@@ -79,12 +79,25 @@ const char *const Settings::getValueTypeString(ValueType type) {
   }
 }
 
-bool Settings::convertStringToBoolean(const std::string &str) {
+bool Settings::convertStringToBoolean(StringRef str) {
   return str::areEqualIgnoreCase(str, "true");
 }
 
-int Settings::convertStringToNumber(const std::string &str) {
-  return static_cast<int>(std::strtol(str.c_str(), nullptr, 10));
+// Parses the way std::strtol() does in base 10, but "str" doesn't have to be
+// null-terminated.
+int Settings::convertStringToNumber(StringRef str) {
+  std::size_t i = 0;
+  while (i < str.size() && std::isspace(static_cast<unsigned char>(str[i])))
+    ++i;
+  bool negative = false;
+  if (i < str.size() && (str[i] == '-' || str[i] == '+'))
+    negative = str[i++] == '-';
+  long n = 0;
+  for (; i < str.size() && std::isdigit(static_cast<unsigned char>(str[i]));
+       ++i)
+    if (n <= (LONG_MAX - 9) / 10)
+      n = n * 10 + (str[i] - '0');
+  return static_cast<int>(negative ? -n : n);
 }
 
 bool Settings::get(const std::string &key, bool &value) const {
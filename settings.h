@@ -22,6 +22,8 @@
 
 #include <assert.h>
 
+#include "stringref.h"
+
 namespace jig {
 
 class Settings {
@@ -33,11 +35,11 @@ public:
     STRING,
   };
 
-  static ValueType getRealValueTypeForValueAsString(const std::string &value);
+  static ValueType getRealValueTypeForValueAsString(StringRef value);
   static const char *const getValueTypeString(ValueType type);
 
-  static bool convertStringToBoolean(const std::string &str);
-  static int convertStringToNumber(const std::string &str);
+  static bool convertStringToBoolean(StringRef str);
+  static int convertStringToNumber(StringRef str);
 
   Settings() = default;
 
@@ -46,6 +48,7 @@ public:
     T value;
     bool r = get(key, value);
     assert(r != false && "Failed to retrieve key/value pair");
+    (void)r;
     return value;
   }
 
@@ -54,6 +57,7 @@ public:
     T value;
     bool r = get(key, value);
     assert(r != false && "Failed to retrieve key/value pair");
+    (void)r;
     return value;
   }
 
@@ -0,0 +1,176 @@
+//===--- spillfile.cc ---------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "spillfile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include "logger.h"
+#include "system.h"
+
+namespace jig {
+namespace {
+
+constexpr char SPILL_FILENAME_TEMPLATE[] = "undo-XXXXXX";
+
+bool writeAll(int fd, const char *data, std::size_t size, off_t offset) {
+  while (size > 0) {
+    ssize_t n = pwrite(fd, data, size, offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+bool readAll(int fd, char *data, std::size_t size, off_t offset) {
+  while (size > 0) {
+    ssize_t n = pread(fd, data, size, offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if (n == 0)
+      return false;
+    data += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+} // namespace
+
+SpillFile::~SpillFile() {
+  if (m_Fd != -1)
+    close(m_Fd);
+}
+
+SpillFile::SpillFile(SpillFile &&other)
+    : m_Fd{other.m_Fd}, m_Chunks{std::move(other.m_Chunks)},
+      m_Length{other.m_Length}, m_Cache{std::move(other.m_Cache)},
+      m_CachedChunk{other.m_CachedChunk} {
+  other.m_Fd = -1;
+  other.m_Chunks.clear();
+  other.m_Length = 0;
+  other.m_CachedChunk = SIZE_MAX;
+}
+
+SpillFile &SpillFile::operator=(SpillFile &&other) {
+  if (this != &other) {
+    if (m_Fd != -1)
+      close(m_Fd);
+    m_Fd = other.m_Fd;
+    m_Chunks = std::move(other.m_Chunks);
+    m_Length = other.m_Length;
+    m_Cache = std::move(other.m_Cache);
+    m_CachedChunk = other.m_CachedChunk;
+    other.m_Fd = -1;
+    other.m_Chunks.clear();
+    other.m_Length = 0;
+    other.m_CachedChunk = SIZE_MAX;
+  }
+  return *this;
+}
+
+bool SpillFile::append(const char *text, std::size_t length) {
+  if (m_Fd == -1 && !openFile())
+    return false;
+
+  uLongf compressedLength = compressBound(length);
+  std::unique_ptr<Bytef[]> compressed{new Bytef[compressedLength]};
+  int r = compress2(compressed.get(), &compressedLength,
+                    reinterpret_cast<const Bytef *>(text), length,
+                    Z_BEST_SPEED);
+  if (r != Z_OK) {
+    Logger::warn("failed to compress undo history -- %s", zError(r));
+    return false;
+  }
+
+  off_t offset = 0;
+  if (!m_Chunks.empty())
+    offset = m_Chunks.back().fileOffset + m_Chunks.back().compressedLength;
+  if (!writeAll(m_Fd, reinterpret_cast<const char *>(compressed.get()),
+                compressedLength, offset)) {
+    Logger::warn("failed to write undo history to disk -- %s",
+                 std::strerror(errno));
+    return false;
+  }
+  m_Chunks.push_back(Chunk{m_Length, length, offset, compressedLength});
+  m_Length += length;
+  return true;
+}
+
+const char *SpillFile::read(std::size_t offset, std::size_t &length) {
+  auto it = std::upper_bound(m_Chunks.begin(), m_Chunks.end(), offset,
+                             [](std::size_t offset, const Chunk &chunk) {
+                               return offset < chunk.textOffset;
+                             });
+  std::size_t index = (it - m_Chunks.begin()) - 1;
+  const Chunk &chunk = m_Chunks[index];
+
+  if (index != m_CachedChunk) {
+    std::unique_ptr<Bytef[]> compressed{new Bytef[chunk.compressedLength]};
+    if (!readAll(m_Fd, reinterpret_cast<char *>(compressed.get()),
+                 chunk.compressedLength, chunk.fileOffset)) {
+      Logger::error("failed to read undo history from disk -- %s",
+                    std::strerror(errno));
+      return nullptr;
+    }
+    m_Cache.resize(chunk.textLength);
+    uLongf rawLength = chunk.textLength;
+    int r = uncompress(reinterpret_cast<Bytef *>(&m_Cache[0]), &rawLength,
+                       compressed.get(), chunk.compressedLength);
+    if (r != Z_OK || rawLength != chunk.textLength) {
+      Logger::error("failed to decompress undo history -- %s", zError(r));
+      m_CachedChunk = SIZE_MAX;
+      return nullptr;
+    }
+    m_CachedChunk = index;
+  }
+
+  std::size_t start = offset - chunk.textOffset;
+  length = chunk.textLength - start;
+  return m_Cache.data() + start;
+}
+
+bool SpillFile::openFile() {
+  std::string path{
+    (System::getProgramDirectory() + SPILL_FILENAME_TEMPLATE).getString()};
+  m_Fd = mkstemp(&path[0]);
+  if (m_Fd == -1) {
+    Logger::warn("failed to create undo history file `%s' -- %s",
+                 path.c_str(), std::strerror(errno));
+    return false;
+  }
+  unlink(path.c_str());
+  return true;
+}
+
+} // namespace jig
@@ -0,0 +1,75 @@
+//===--- spillfile.h ----------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_SPILLFILE_H__
+#define __JIG_SPILLFILE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace jig {
+
+// Text moved out of memory and into a file under the program directory, as a
+// series of zlib-compressed chunks. Text can only be added to the end, but
+// any of it can be read back. The file is unlinked as soon as it's created,
+// so it goes away with the process.
+class SpillFile {
+public:
+  SpillFile() = default;
+  ~SpillFile();
+
+  SpillFile(SpillFile &&other);
+  SpillFile &operator=(SpillFile &&other);
+
+  SpillFile(const SpillFile &) = delete;
+  SpillFile &operator=(const SpillFile &) = delete;
+
+  std::size_t getLength() const { return m_Length; }
+
+  // Adds "length" bytes of text as a chunk of its own. Returns false if it
+  // couldn't be written, in which case it's up to the caller to keep it.
+  bool append(const char *text, std::size_t length);
+
+  // Returns the text at "offset", and sets "length" to how much of it can be
+  // read from there on, which is as far as the end of the chunk. The text
+  // stays valid until the next read(). Returns nullptr if it can't be read.
+  const char *read(std::size_t offset, std::size_t &length);
+
+private:
+  struct Chunk {
+    std::size_t textOffset;
+    std::size_t textLength;
+    off_t fileOffset;
+    std::size_t compressedLength;
+  };
+
+  bool openFile();
+
+  int m_Fd = -1;
+  std::vector<Chunk> m_Chunks;
+  std::size_t m_Length = 0;
+
+  // The last chunk that was read, decompressed.
+  std::string m_Cache;
+  std::size_t m_CachedChunk = SIZE_MAX;
+};
+
+} // namespace jig
+
+#endif // __JIG_SPILLFILE_H__
@@ -24,6 +24,8 @@ namespace {
 
 constexpr char TOP_STRING[] = "Top";
 constexpr char BOTTOM_STRING[] = "Bottom";
+constexpr char MAPPED_STRING[] = " [mmap]";
+constexpr char INDEXING_FORMAT[] = " [indexing... %u%%]";
 
 } // namespace
 
@@ -46,6 +48,14 @@ int StatusBar::getKeypress() {
 void StatusBar::update() {
   const Document &doc = App::getInstance().getDocumentList().getCurrent();
   m_Text = doc.getTitle();
+  if (doc.isMapped())
+    m_Text += MAPPED_STRING;
+  if (!doc.getBuffer()->isIndexed()) {
+    char indexingStr[32];
+    snprintf(indexingStr, sizeof(indexingStr), INDEXING_FORMAT,
+             doc.getBuffer()->getIndexedPercent());
+    m_Text += indexingStr;
+  }
 #ifndef NDEBUG
   m_BufferPos = doc.getCursorPosition();
 #endif
@@ -0,0 +1,65 @@
+//===--- storage.cc -----------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "storage.h"
+
+#include <assert.h>
+
+#include "chunkiterator.h"
+
+namespace jig {
+namespace {
+
+class StringSnapshot : public Storage::Snapshot {
+public:
+  StringSnapshot(std::string str) : m_Str{std::move(str)} {}
+
+  virtual std::size_t getLength() const final { return m_Str.size(); }
+
+  virtual Storage::Chunk getChunkAt(std::size_t pos) const final {
+    assert(pos < m_Str.size() && "Position is out of bounds");
+    return Storage::Chunk{m_Str.data(), m_Str.size(), 0};
+  }
+
+private:
+  std::string m_Str;
+};
+
+} // namespace
+
+std::string Storage::getStringAt(std::size_t pos, std::size_t count) const {
+  std::size_t len = getLength();
+  assert(pos <= len && "Position is out of bounds");
+  if (count > len - pos)
+    count = len - pos;
+
+  std::string ret;
+  ret.reserve(count);
+  for (ChunkIterator<Storage> it{*this, pos, pos + count}; it.isValid(); ++it)
+    ret.append((*it).data(), (*it).size());
+  return ret;
+}
+
+Storage::Chunk StringStorage::getChunkAt(std::size_t pos) const {
+  assert(pos < m_Str.size() && "Position is out of bounds");
+  return Chunk{m_Str.data(), m_Str.size(), 0};
+}
+
+std::unique_ptr<Storage::Snapshot> StringStorage::getSnapshot() const {
+  return std::make_unique<StringSnapshot>(m_Str);
+}
+
+} // namespace jig
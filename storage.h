@@ -0,0 +1,106 @@
+//===--- storage.h ------------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_STORAGE_H__
+#define __JIG_STORAGE_H__
+
+#include <memory>
+#include <string>
+
+namespace jig {
+
+// The backing store for the text of a Buffer. A Buffer only ever talks to its
+// contents through this interface, which lets the way the text is laid out in
+// memory be chosen when the Buffer is constructed.
+class Storage {
+public:
+  enum class Type {
+    STRING,
+    PIECE_TABLE,
+  };
+
+  // A contiguous run of bytes that starts at position "pos" in the text.
+  struct Chunk {
+    const char *data;
+    std::size_t length;
+    std::size_t pos;
+  };
+
+  // A read-only copy of the text as it was when it was taken. It isn't
+  // affected by anything done to the Storage afterwards, and can be read from
+  // another thread while the Storage is being edited.
+  class Snapshot {
+  public:
+    virtual ~Snapshot() {}
+
+    virtual std::size_t getLength() const = 0;
+    virtual Chunk getChunkAt(std::size_t pos) const = 0;
+  };
+
+  virtual ~Storage() {}
+
+  virtual Type getType() const = 0;
+  virtual std::size_t getLength() const = 0;
+
+  virtual char getCharAt(std::size_t pos) const = 0;
+
+  // Returns the largest contiguous Chunk that contains "pos".
+  virtual Chunk getChunkAt(std::size_t pos) const = 0;
+
+  virtual std::string getStringAt(std::size_t pos, std::size_t count) const;
+
+  virtual std::unique_ptr<Snapshot> getSnapshot() const = 0;
+
+  virtual void insert(std::size_t pos, const char *str, std::size_t len) = 0;
+  virtual void erase(std::size_t pos, std::size_t count) = 0;
+};
+
+// Keeps the entire text in a single std::string. Every insert or erase moves
+// everything after the edit, so this is only meant for small texts.
+class StringStorage : public Storage {
+public:
+  StringStorage(std::string str) : m_Str{std::move(str)} {}
+
+  virtual Type getType() const final { return Type::STRING; }
+  virtual std::size_t getLength() const final { return m_Str.size(); }
+
+  virtual char getCharAt(std::size_t pos) const final { return m_Str[pos]; }
+  virtual Chunk getChunkAt(std::size_t pos) const final;
+
+  virtual std::string getStringAt(std::size_t pos,
+                                  std::size_t count) const final {
+    return m_Str.substr(pos, count);
+  }
+
+  // There's no way to share the text, so this copies all of it.
+  virtual std::unique_ptr<Snapshot> getSnapshot() const final;
+
+  virtual void insert(std::size_t pos, const char *str,
+                      std::size_t len) final {
+    m_Str.insert(pos, str, len);
+  }
+
+  virtual void erase(std::size_t pos, std::size_t count) final {
+    m_Str.erase(pos, count);
+  }
+
+private:
+  std::string m_Str;
+};
+
+} // namespace jig
+
+#endif // __JIG_STORAGE_H__
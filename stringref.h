@@ -0,0 +1,80 @@
+//===--- stringref.h ----------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_STRINGREF_H__
+#define __JIG_STRINGREF_H__
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace jig {
+
+// A view of "size" characters that belong to someone else, such as a Chunk of
+// a Buffer. It's only good for as long as they are left alone. This is
+// std::string_view for a C++14 tree.
+class StringRef {
+public:
+  static constexpr std::size_t npos = std::string::npos;
+
+  StringRef() = default;
+  StringRef(const char *data, std::size_t size) : m_Data{data}, m_Size{size} {}
+  StringRef(const char *str) : m_Data{str}, m_Size{std::strlen(str)} {}
+  StringRef(const std::string &str) : m_Data{str.data()}, m_Size{str.size()} {}
+
+  const char *data() const { return m_Data; }
+  std::size_t size() const { return m_Size; }
+  std::size_t length() const { return m_Size; }
+  bool empty() const { return m_Size == 0; }
+
+  const char *begin() const { return m_Data; }
+  const char *end() const { return m_Data + m_Size; }
+
+  char operator[](std::size_t i) const { return m_Data[i]; }
+
+  StringRef substr(std::size_t pos, std::size_t count = npos) const {
+    if (pos > m_Size)
+      pos = m_Size;
+    if (count > m_Size - pos)
+      count = m_Size - pos;
+    return StringRef{m_Data + pos, count};
+  }
+
+  std::size_t find(char ch, std::size_t pos = 0) const {
+    if (pos >= m_Size)
+      return npos;
+    const void *p = std::memchr(m_Data + pos, ch, m_Size - pos);
+    if (!p)
+      return npos;
+    return static_cast<const char *>(p) - m_Data;
+  }
+
+  std::string toString() const { return std::string{m_Data, m_Size}; }
+
+  bool operator==(StringRef other) const {
+    return m_Size == other.m_Size &&
+           (m_Size == 0 || std::memcmp(m_Data, other.m_Data, m_Size) == 0);
+  }
+  bool operator!=(StringRef other) const { return !(*this == other); }
+
+private:
+  const char *m_Data = "";
+  std::size_t m_Size = 0;
+};
+
+} // namespace jig
+
+#endif // __JIG_STRINGREF_H__
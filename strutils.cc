@@ -18,32 +18,159 @@
 
 #include <cctype>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JIG_X86_SIMD 1
+#endif
+
 namespace jig {
 namespace str {
 namespace {
 
-std::string convertAllToLowercase(const std::string &str) {
-  std::string r;
-  r.reserve(str.size());
-  std::for_each(str.begin(), str.end(),
-                [&r](const char &c) { r += std::tolower(c); });
-  return r;
+using FindAllFunc = std::size_t (*)(const char *, std::size_t, char,
+                                    std::size_t *, std::size_t, std::size_t &);
+using OccursFunc = std::size_t (*)(const char *, std::size_t, char);
+
+// The vectorized versions below hand whatever is left over at the end, which
+// is less than one vector's worth, to these. "pos" is where to pick up from
+// and "n" is how many offsets have already been found.
+std::size_t findAllScalar(const char *data, std::size_t pos, std::size_t len,
+                          char ch, std::size_t *offsets, std::size_t n,
+                          std::size_t max, std::size_t &searched) {
+  for (; pos < len; ++pos) {
+    if (data[pos] != ch)
+      continue;
+    offsets[n++] = pos;
+    if (n == max) {
+      searched = pos + 1;
+      return n;
+    }
+  }
+  searched = len;
+  return n;
 }
 
-} // namespace
+std::size_t findAllScalar(const char *data, std::size_t len, char ch,
+                          std::size_t *offsets, std::size_t max,
+                          std::size_t &searched) {
+  return findAllScalar(data, 0, len, ch, offsets, 0, max, searched);
+}
 
-std::size_t occurs(const std::string &str, char ch) {
+std::size_t occursScalar(const char *data, std::size_t len, char ch) {
   std::size_t count = 0;
-  std::for_each(str.begin(), str.end(), [ch, &count](const char &c) {
-    if (c == ch)
+  for (std::size_t i = 0; i < len; ++i)
+    if (data[i] == ch)
       ++count;
-  });
   return count;
 }
 
+#ifdef JIG_X86_SIMD
+// Each of these compares a whole vector at a time and turns the result into
+// a bit mask with one bit per byte, so that the matches can be walked with
+// one count-trailing-zeros per match instead of one compare per byte.
+
+__attribute__((target("sse2"))) std::size_t
+findAllSSE2(const char *data, std::size_t len, char ch, std::size_t *offsets,
+            std::size_t max, std::size_t &searched) {
+  const __m128i needle = _mm_set1_epi8(ch);
+  std::size_t n = 0;
+  std::size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+    for (; mask != 0; mask &= mask - 1) {
+      std::size_t offset = i + __builtin_ctz(mask);
+      offsets[n++] = offset;
+      if (n == max) {
+        searched = offset + 1;
+        return n;
+      }
+    }
+  }
+  return findAllScalar(data, i, len, ch, offsets, n, max, searched);
+}
+
+__attribute__((target("avx2"))) std::size_t
+findAllAVX2(const char *data, std::size_t len, char ch, std::size_t *offsets,
+            std::size_t max, std::size_t &searched) {
+  const __m256i needle = _mm256_set1_epi8(ch);
+  std::size_t n = 0;
+  std::size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i v =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+    for (; mask != 0; mask &= mask - 1) {
+      std::size_t offset = i + __builtin_ctz(mask);
+      offsets[n++] = offset;
+      if (n == max) {
+        searched = offset + 1;
+        return n;
+      }
+    }
+  }
+  return findAllScalar(data, i, len, ch, offsets, n, max, searched);
+}
+
+__attribute__((target("sse2,popcnt"))) std::size_t
+occursSSE2(const char *data, std::size_t len, char ch) {
+  const __m128i needle = _mm_set1_epi8(ch);
+  std::size_t count = 0;
+  std::size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+  }
+  return count + occursScalar(data + i, len - i, ch);
+}
+
+__attribute__((target("avx2,popcnt"))) std::size_t
+occursAVX2(const char *data, std::size_t len, char ch) {
+  const __m256i needle = _mm256_set1_epi8(ch);
+  std::size_t count = 0;
+  std::size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i v =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    count +=
+      __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+  }
+  return count + occursScalar(data + i, len - i, ch);
+}
+#endif
+
+FindAllFunc selectFindAll() {
+#ifdef JIG_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return findAllAVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return findAllSSE2;
+#endif
+  return findAllScalar;
+}
+
+OccursFunc selectOccurs() {
+#ifdef JIG_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    return occursAVX2;
+  if (__builtin_cpu_supports("sse2") && __builtin_cpu_supports("popcnt"))
+    return occursSSE2;
+#endif
+  return occursScalar;
+}
+
+} // namespace
+
+std::size_t occurs(const std::string &str, char ch) {
+  return occurs(str.data(), str.size(), ch);
+}
+
 std::size_t occurs(const std::string &str, const std::string &s) {
   std::size_t p = str.find(s);
   if (p == std::string::npos)
@@ -59,12 +186,35 @@ std::size_t occurs(const std::string &str, const std::string &s) {
   return count;
 }
 
+std::size_t occurs(const char *data, std::size_t len, char ch) {
+  static const OccursFunc func = selectOccurs();
+  return func(data, len, ch);
+}
+
+std::size_t findAll(const char *data, std::size_t len, char ch,
+                    std::size_t *offsets, std::size_t max,
+                    std::size_t &searched) {
+  static const FindAllFunc func = selectFindAll();
+  if (max == 0) {
+    searched = 0;
+    return 0;
+  }
+  return func(data, len, ch, offsets, max, searched);
+}
+
 std::vector<std::size_t> findAllPositions(const std::string &str, char ch) {
   std::vector<std::size_t> r;
+  std::size_t offsets[256];
+  std::size_t p = 0;
   std::size_t len = str.size();
-  for (std::size_t p = 0; p != len; ++p)
-    if (str[p] == ch)
-      r.emplace_back(p);
+  while (p < len) {
+    std::size_t searched;
+    std::size_t n =
+      findAll(str.data() + p, len - p, ch, offsets, 256, searched);
+    for (std::size_t i = 0; i < n; ++i)
+      r.emplace_back(p + offsets[i]);
+    p += searched;
+  }
   return r;
 }
 
@@ -92,8 +242,26 @@ void stripAllWhitespace(std::string &str) {
       str.erase(I);
 }
 
-bool areEqualIgnoreCase(const std::string &str1, const std::string &str2) {
-  return convertAllToLowercase(str1) == convertAllToLowercase(str2);
+bool areEqualIgnoreCase(StringRef str1, StringRef str2) {
+  if (str1.size() != str2.size())
+    return false;
+  for (std::size_t i = 0; i < str1.size(); ++i) {
+    int c1 = std::tolower(static_cast<unsigned char>(str1[i]));
+    int c2 = std::tolower(static_cast<unsigned char>(str2[i]));
+    if (c1 != c2)
+      return false;
+  }
+  return true;
+}
+
+std::uint64_t hash(const char *data, std::size_t len, std::uint64_t seed) {
+  constexpr std::uint64_t FNV_PRIME = 1099511628211ULL;
+  std::uint64_t h = seed;
+  for (std::size_t i = 0; i < len; ++i) {
+    h ^= static_cast<unsigned char>(data[i]);
+    h *= FNV_PRIME;
+  }
+  return h;
 }
 
 std::string format(const char *fmt, ...) {
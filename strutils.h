@@ -1,14 +1,29 @@
 #ifndef __JIG_STRUTILS_H__
 #define __JIG_STRUTILS_H__
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "stringref.h"
+
 namespace jig {
 namespace str {
 
 std::size_t occurs(const std::string &str, char ch);
 std::size_t occurs(const std::string &str, const std::string &s);
+std::size_t occurs(const char *data, std::size_t len, char ch);
+
+// Searches the "len" bytes at "data" for "ch", storing the offset of each one
+// in "offsets" until "max" have been found. Returns how many were found, and
+// sets "searched" to the number of bytes that were looked at. That number is
+// only less than "len" if the search stopped because "offsets" filled up.
+//
+// This and occurs() use the widest vector instructions the CPU supports.
+std::size_t findAll(const char *data, std::size_t len, char ch,
+                    std::size_t *offsets, std::size_t max,
+                    std::size_t &searched);
 
 std::vector<std::size_t> findAllPositions(const std::string &str, char ch);
 std::vector<std::size_t> findAllPositions(const std::string &str,
@@ -16,7 +31,14 @@ std::vector<std::size_t> findAllPositions(const std::string &str,
 
 void stripAllWhitespace(std::string &str);
 
-bool areEqualIgnoreCase(const std::string &str1, const std::string &str2);
+bool areEqualIgnoreCase(StringRef str1, StringRef str2);
+
+// A 64-bit FNV-1a hash of the "len" bytes at "data". Text that comes in
+// pieces is hashed by passing the hash of everything before each piece back
+// in as "seed".
+constexpr std::uint64_t HASH_SEED = 14695981039346656037ULL;
+std::uint64_t hash(const char *data, std::size_t len,
+                   std::uint64_t seed = HASH_SEED);
 
 std::string format(const char *fmt, ...);
 
@@ -17,6 +17,8 @@
 #include "system.h"
 
 #include <cerrno>
+#include <cinttypes>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
@@ -25,6 +27,7 @@
 
 #include "file.h"
 #include "logger.h"
+#include "strutils.h"
 
 namespace jig {
 namespace {
@@ -36,6 +39,9 @@ constexpr char LOCAL_FIG_FILENAME[] = ".jigfig";
 
 constexpr char LOG_FILENAME[] = "log";
 
+constexpr char UNDO_DIRNAME[] = "undo";
+constexpr char RECOVERY_DIRNAME[] = "recovery";
+
 } // namespace
 
 const char *System::getEnvironmentVariable(const char *key) {
@@ -69,6 +75,27 @@ Path System::getLogPath() {
   return getProgramDirectory() + LOG_FILENAME;
 }
 
+Path System::getUndoDirectory() {
+  return getProgramDirectory() + UNDO_DIRNAME;
+}
+
+Path System::getRecoveryDirectory() {
+  return getProgramDirectory() + RECOVERY_DIRNAME;
+}
+
+std::string System::getStateName(const Path &filePath) {
+  std::string key = filePath.getString();
+  char *resolved = realpath(filePath.getCString(), nullptr);
+  if (resolved) {
+    key = resolved;
+    std::free(resolved);
+  }
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016" PRIx64,
+                str::hash(key.data(), key.size()));
+  return name;
+}
+
 void System::makeDirectory(const Path &path) {
   if (File::directoryExists(path))
     return;
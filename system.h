@@ -17,6 +17,8 @@
 #ifndef __JIG_SYSTEM_H__
 #define __JIG_SYSTEM_H__
 
+#include <string>
+
 #include "path.h"
 
 namespace jig {
@@ -32,6 +34,12 @@ struct System {
   static Path getLocalFigPath();
 
   static Path getLogPath();
+  static Path getUndoDirectory();
+  static Path getRecoveryDirectory();
+
+  // A name to keep things about the file at "filePath" under, which is the
+  // same however the path to it is written.
+  static std::string getStateName(const Path &filePath);
 
   static void makeDirectory(const Path &path);
 };
@@ -0,0 +1,132 @@
+//===--- terminalscreen.cc ----------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "terminalscreen.h"
+
+#include <ncurses.h>
+
+#include "color.h"
+
+namespace jig {
+namespace {
+
+static_assert(Screen::NO_KEY == ERR, "NO_KEY has to match ncurses");
+
+class TerminalSurface : public Screen::Surface {
+public:
+  explicit TerminalSurface(WINDOW *win) : m_Win{win} {}
+  ~TerminalSurface() { delwin(m_Win); }
+
+  virtual void moveCursor(int y, int x) final { wmove(m_Win, y, x); }
+  virtual void setKeypad(bool enabled) final { keypad(m_Win, enabled); }
+  virtual void setAttrs(int attrs) final { wattrset(m_Win, attrs); }
+  virtual void setBackground(int attrs) final { wbkgd(m_Win, attrs); }
+
+  virtual void put(int y, int x, char ch) final {
+    mvwaddch(m_Win, y, x, ch);
+  }
+
+  virtual void put(int y, int x, const char *str, std::size_t count) final {
+    mvwaddnstr(m_Win, y, x, str, count);
+  }
+
+  virtual int getKeypress() final { return wgetch(m_Win); }
+  virtual void setInputTimeout(int millis) final { wtimeout(m_Win, millis); }
+
+  virtual void clear() final { wclear(m_Win); }
+
+  virtual void clearToEndOfLine(int y, int x) final {
+    if (wmove(m_Win, y, x) != ERR)
+      wclrtoeol(m_Win);
+  }
+
+  virtual bool move(int y, int x) final { return mvwin(m_Win, y, x) != ERR; }
+
+  virtual bool resize(int h, int w) final {
+    int y;
+    int x;
+    getbegyx(m_Win, y, x);
+    WINDOW *win = newwin(h, w, y, x);
+    if (!win)
+      return false;
+    delwin(m_Win);
+    m_Win = win;
+    return true;
+  }
+
+  virtual void refresh() final { wrefresh(m_Win); }
+
+private:
+  WINDOW *m_Win;
+};
+
+} // namespace
+
+bool TerminalScreen::start() {
+  if (m_Started)
+    return true;
+  if (!initscr())
+    return false;
+
+  noecho();
+  cbreak();
+  raw();
+  set_escdelay(25);
+  keypad(stdscr, true);
+  Color::init();
+
+  m_Started = true;
+  return true;
+}
+
+void TerminalScreen::stop() {
+  if (!m_Started)
+    return;
+  endwin();
+  m_Started = false;
+}
+
+void TerminalScreen::reset() {
+  endwin();
+  ::refresh();
+  ::clear();
+}
+
+int TerminalScreen::getHeight() const {
+  return getmaxy(stdscr);
+}
+
+int TerminalScreen::getWidth() const {
+  return getmaxx(stdscr);
+}
+
+void TerminalScreen::defineKey(const char *seq, int key) {
+  define_key(seq, key);
+}
+
+std::unique_ptr<Screen::Surface> TerminalScreen::createSurface(int h, int w,
+                                                               int y, int x) {
+  WINDOW *win = newwin(h, w, y, x);
+  if (!win)
+    return nullptr;
+  return std::make_unique<TerminalSurface>(win);
+}
+
+void TerminalScreen::refresh() {
+  ::refresh();
+}
+
+} // namespace jig
@@ -0,0 +1,54 @@
+//===--- terminalscreen.h -----------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_TERMINALSCREEN_H__
+#define __JIG_TERMINALSCREEN_H__
+
+#include "screen.h"
+
+namespace jig {
+
+// The terminal jig was started in, drawn on through ncurses.
+class TerminalScreen : public Screen {
+public:
+  TerminalScreen() = default;
+  ~TerminalScreen() { stop(); }
+
+  virtual Type getType() const final { return Type::TERMINAL; }
+
+  virtual bool start() final;
+  virtual void stop() final;
+  virtual void reset() final;
+
+  virtual int getHeight() const final;
+  virtual int getWidth() const final;
+
+  virtual void defineKey(const char *seq, int key) final;
+
+  // There's always more to wait for from a terminal.
+  virtual bool hasMoreInput() const final { return true; }
+
+  virtual std::unique_ptr<Surface> createSurface(int h, int w, int y,
+                                                 int x) final;
+  virtual void refresh() final;
+
+private:
+  bool m_Started = false;
+};
+
+} // namespace jig
+
+#endif // __JIG_TERMINALSCREEN_H__
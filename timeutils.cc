@@ -171,6 +171,12 @@ std::string Timer::getFormatString(FormatStringStyle style) const {
   return ets.getString();
 }
 
+long getNanosSinceEpoch() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec * Timer::NANOS_PER_SEC + ts.tv_nsec;
+}
+
 std::string getDateTimeFormatString(const char *format) {
   std::time_t now = std::time(nullptr);
   std::tm *t = std::localtime(&now);
@@ -75,6 +75,10 @@ private:
   long m_Stop = 0L;
 };
 
+// Wall-clock time, so unlike a Timer's, it still means something to a later
+// run of the program.
+long getNanosSinceEpoch();
+
 // The "format" argument is passed straight to std::strftime.
 // The default value for "format" gives the full date and time:
 //   <day of week> <month> <day of month> <time> <timezone> <year>
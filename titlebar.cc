@@ -23,13 +23,27 @@
 #include "ui.h"
 
 namespace jig {
+namespace {
+
+// Returns the character to show next to a Document's title, or 0 for none.
+char getMarker(const Document &doc) {
+  if (doc.isSaving())
+    return '~';
+  if (doc.didSaveFail())
+    return '!';
+  if (doc.isDirty())
+    return '+';
+  return 0;
+}
+
+} // namespace
 
 void TitleBar::init() {
   const auto &docs = App::getInstance().getDocumentList();
 
   m_Titles.reserve(docs.getTotal());
   std::for_each(docs.begin(), docs.end(), [&](const auto &doc) {
-    m_Titles.emplace_back(doc.getTitle(), doc.isDirty());
+    m_Titles.emplace_back(doc.getTitle(), getMarker(doc));
   });
   initRepr();
   initWindow();
@@ -48,14 +62,26 @@ int TitleBar::getKeypress() {
 }
 
 void TitleBar::update() {
+  // Laying the titles out again makes a new Window, which has to be written
+  // to the screen in full, so only do that when a marker has changed. Which
+  // title is highlighted can change without that.
   const auto &docs = App::getInstance().getDocumentList();
-  for (std::size_t i = 0; i < docs.getTotal(); ++i)
-    m_Titles[i].dirty = docs[i].isDirty();
-  updateDimensions();
+  bool changed = false;
+  for (std::size_t i = 0; i < docs.getTotal(); ++i) {
+    char marker = getMarker(docs[i]);
+    if (m_Titles[i].marker != marker) {
+      m_Titles[i].marker = marker;
+      changed = true;
+    }
+  }
+  if (changed)
+    updateDimensions();
+  else
+    writeToWindow();
 }
 
 void TitleBar::addTitle(const Document &doc) {
-  m_Titles.emplace_back(doc.getTitle(), doc.isDirty());
+  m_Titles.emplace_back(doc.getTitle(), getMarker(doc));
   updateDimensions();
 }
 
@@ -80,7 +106,7 @@ void TitleBar::initRepr() {
   m_Repr.push_back(std::vector<const Title *>{});
   std::for_each(m_Titles.begin(), m_Titles.end(), [&](const auto &title) {
     titleLen = title.str.size();
-    if (title.dirty)
+    if (title.marker)
       ++titleLen;
     if (xPos + titleLen + 2 >= width) {
       m_Repr.push_back(std::vector<const Title *>{});
@@ -111,14 +137,15 @@ void TitleBar::writeToWindow() {
   // |_______________________________________|
   //
   // A title with a '+' next to it means it has been modified and hasn't been
-  // saved yet.
+  // saved yet. A '~' means it is being saved right now, and a '!' means the
+  // last attempt to save it failed.
   std::for_each(m_Repr.begin(), m_Repr.end(), [&](const auto &row) {
     std::for_each(row.begin(), row.end(), [&](const auto &title) {
       m_Window->put(y, x++, '[');
       if (i == currentDocIndex)
         m_Window->enableAttrs(Window::Attr::UNDERLINE | Window::Attr::BOLD);
-      if (title->dirty)
-        m_Window->put(y, x++, '+');
+      if (title->marker)
+        m_Window->put(y, x++, title->marker);
       m_Window->put(y, x, title->str);
       x += title->str.size();
       if (i++ == currentDocIndex)
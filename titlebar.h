@@ -45,9 +45,9 @@ private:
   void writeToWindow();
 
   struct Title {
-    Title(const std::string &s, bool d) : str{s}, dirty{d} {}
+    Title(const std::string &s, char m) : str{s}, marker{m} {}
     std::string str;
-    bool dirty;
+    char marker;
   };
 
   std::vector<Title> m_Titles;
@@ -23,8 +23,8 @@
 #include <ncurses.h>
 
 #include "app.h"
-#include "color.h"
 #include "logger.h"
+#include "terminalscreen.h"
 
 namespace jig {
 namespace {
@@ -33,7 +33,7 @@ constexpr int KEY_BACKSPACE_CUSTOM = 127;
 constexpr int KEY_NEWLINE = '\n';
 constexpr int KEY_TAB = '\t';
 
-// constexpr int KEY_CTRL_A = 1;
+constexpr int KEY_CTRL_A = 1;
 // constexpr int KEY_CTRL_B = 2;
 constexpr int KEY_CTRL_C = 3;
 // constexpr int KEY_CTRL_D = 4;
@@ -69,48 +69,46 @@ constexpr int KEY_SHIFT_ALT_RIGHT = KEY_MAX + 6;
 constexpr int KEY_SHIFT_ALT_UP = KEY_MAX + 7;
 constexpr int KEY_SHIFT_ALT_DOWN = KEY_MAX + 8;
 
-void resizeHandler(int sig) {
-  endwin();
-  refresh();
-  clear();
+// How much more of a Buffer gets indexed each time there's no input waiting.
+constexpr std::size_t INDEX_STEP_SIZE = 4 * 1024 * 1024;
+
+// How often to check whether a save has finished when there's no input.
+constexpr int SAVE_POLL_MILLIS = 50;
 
+void resizeHandler(int sig) {
   UI &ui = App::getInstance().getUI();
+  ui.getScreen().reset();
   ui.updateDimensions();
   ui.draw();
 }
 
 } // namespace
 
-const int UI::INVALID_INPUT = ERR;
+const int UI::INVALID_INPUT = Screen::NO_KEY;
 
-void UI::start() {
+void UI::start(std::unique_ptr<Screen> screen /*=nullptr*/) {
   if (m_Running)
     return;
 
-  if (!initscr()) {
+  m_Screen = screen ? std::move(screen) : std::make_unique<TerminalScreen>();
+  if (!m_Screen->start()) {
     Logger::fatal("failed to initialize Ncurses");
     std::exit(EXIT_FAILURE);
   }
 
-  noecho();
-  cbreak();
-  raw();
-  set_escdelay(25);
-  keypad(stdscr, true);
-
-  define_key("\033\033\[D", KEY_ALT_LEFT);
-  define_key("\033\033\[C", KEY_ALT_RIGHT);
-  define_key("\033\033\[A", KEY_ALT_UP);
-  define_key("\033\033\[B", KEY_ALT_DOWN);
-  define_key("\033\[1;10D", KEY_SHIFT_ALT_LEFT);
-  define_key("\033\[1;10C", KEY_SHIFT_ALT_RIGHT);
-  define_key("\033\[1;10A", KEY_SHIFT_ALT_UP);
-  define_key("\033\[1;10B", KEY_SHIFT_ALT_DOWN);
+  m_Screen->defineKey("\033\033\[D", KEY_ALT_LEFT);
+  m_Screen->defineKey("\033\033\[C", KEY_ALT_RIGHT);
+  m_Screen->defineKey("\033\033\[A", KEY_ALT_UP);
+  m_Screen->defineKey("\033\033\[B", KEY_ALT_DOWN);
+  m_Screen->defineKey("\033\[1;10D", KEY_SHIFT_ALT_LEFT);
+  m_Screen->defineKey("\033\[1;10C", KEY_SHIFT_ALT_RIGHT);
+  m_Screen->defineKey("\033\[1;10A", KEY_SHIFT_ALT_UP);
+  m_Screen->defineKey("\033\[1;10B", KEY_SHIFT_ALT_DOWN);
 
-  Color::init();
-
-  getmaxyx(stdscr, m_Height, m_Width);
-  std::signal(SIGWINCH, resizeHandler);
+  m_Height = m_Screen->getHeight();
+  m_Width = m_Screen->getWidth();
+  if (m_Screen->getType() == Screen::Type::TERMINAL)
+    std::signal(SIGWINCH, resizeHandler);
 
   if (App::getInstance().getFig()->get<bool>("ShowLineNumbers"))
     m_LineNumberColumn = std::make_unique<LineNumberColumn>();
@@ -127,14 +125,19 @@ void UI::start() {
 void UI::stop() {
   if (!m_Running)
     return;
-  endwin();
+  m_Screen->stop();
+  Logger::info("BufferView row cache: %llu hits, %llu misses",
+               static_cast<unsigned long long>(m_BufferView.getRowCacheHits()),
+               static_cast<unsigned long long>(
+                 m_BufferView.getRowCacheMisses()));
 }
 
 void UI::updateDimensions() {
   if (!m_Running)
     return;
 
-  getmaxyx(stdscr, m_Height, m_Width);
+  m_Height = m_Screen->getHeight();
+  m_Width = m_Screen->getWidth();
 
   m_TitleBar.updateDimensions();
   m_StatusBar.updateDimensions();
@@ -146,7 +149,7 @@ void UI::updateDimensions() {
 }
 
 void UI::draw() {
-  ::refresh();
+  m_Screen->refresh();
 
   m_TitleBar.draw();
   m_StatusBar.draw();
@@ -158,10 +161,26 @@ void UI::draw() {
 }
 
 void UI::handleInput() {
-  int k = m_BufferView.getKeypress();
   auto &app = App::getInstance();
   auto &docList = app.getDocumentList();
 
+  bool saving = checkOnSaves();
+
+  // Only block waiting for input when there's nothing left to do between
+  // keypresses.
+  if (!docList.getCurrent().getBuffer()->isIndexed())
+    m_BufferView.setInputTimeout(0);
+  else if (saving)
+    m_BufferView.setInputTimeout(SAVE_POLL_MILLIS);
+  else
+    m_BufferView.setInputTimeout(-1);
+
+  int k = m_BufferView.getKeypress();
+  if (k == INVALID_INPUT) {
+    handleIdle();
+    return;
+  }
+
   switch (k) {
     case KEY_LEFT:
       docList.getCurrent().moveCursorLeft();
@@ -188,6 +207,28 @@ void UI::handleInput() {
       docList.setNextAsCurrent();
       update(true, true, true);
       break;
+    case KEY_SHIFT_ALT_UP:
+      docList.getCurrent().goBackInTime();
+      update(true, true, true);
+      break;
+    case KEY_SHIFT_ALT_DOWN:
+      docList.getCurrent().goForwardInTime();
+      update(true, true, true);
+      break;
+    case KEY_CTRL_A:
+      // Replaces every occurrence of the selected text with what's on the
+      // clipboard. Like pasting, it does nothing while the clipboard is
+      // empty, rather than erasing every occurrence.
+      if (app.getCurrentMode() == App::Mode::SELECT &&
+          !app.getClipboard().isEmpty()) {
+        auto &doc = docList.getCurrent();
+        auto &smh = app.getSelectModeHandler();
+        doc.replaceAll(smh.getText(doc), app.getClipboard().getContent());
+        app.setCurrentMode(App::Mode::NORMAL);
+        smh.reset();
+        update(true, true, true);
+      }
+      break;
     case KEY_CTRL_C:
       if (app.getCurrentMode() == App::Mode::SELECT) {
         app.getClipboard().setContent(
@@ -270,6 +311,30 @@ void UI::handleInput() {
   }
 }
 
+// Returns true if any Document is still being saved.
+bool UI::checkOnSaves() {
+  bool finished = false;
+  bool saving = false;
+  for (auto &doc : App::getInstance().getDocumentList()) {
+    if (doc.checkOnSave())
+      finished = true;
+    if (doc.isSaving())
+      saving = true;
+  }
+  if (finished)
+    update(true, false, false);
+  return saving;
+}
+
+void UI::handleIdle() {
+  auto &doc = App::getInstance().getDocumentList().getCurrent();
+  Buffer *buffer = doc.getBuffer();
+  if (buffer->isIndexed())
+    return;
+  buffer->indexMore(INDEX_STEP_SIZE);
+  update(false, true, buffer->isIndexed());
+}
+
 void UI::update(bool updateTitleBar, bool updateStatusBar,
                 bool updateBufferView) {
   if (updateTitleBar)
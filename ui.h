@@ -17,8 +17,11 @@
 #ifndef __JIG_UI_H__
 #define __JIG_UI_H__
 
+#include <memory>
+
 #include "bufferview.h"
 #include "linenumbercolumn.h"
+#include "screen.h"
 #include "statusbar.h"
 #include "titlebar.h"
 
@@ -31,7 +34,8 @@ public:
   UI() = default;
   ~UI() { stop(); }
 
-  void start();
+  // Draws on "screen", or on the terminal if there isn't one.
+  void start(std::unique_ptr<Screen> screen = nullptr);
   void stop();
   void updateDimensions();
   void draw();
@@ -41,6 +45,9 @@ public:
   int getWidth() const { return m_Width; }
   bool isCurrentlyRunning() const { return m_Running; }
 
+  Screen &getScreen() { return *m_Screen; }
+  const Screen &getScreen() const { return *m_Screen; }
+
   TitleBar &getTitleBar() { return m_TitleBar; }
   const TitleBar &getTitleBar() const { return m_TitleBar; }
 
@@ -56,8 +63,11 @@ public:
   }
 
 private:
+  bool checkOnSaves();
+  void handleIdle();
   void update(bool updateTitleBar, bool updateStatusBar, bool updateBufferView);
 
+  std::unique_ptr<Screen> m_Screen = nullptr;
   TitleBar m_TitleBar;
   StatusBar m_StatusBar;
   BufferView m_BufferView;
@@ -0,0 +1,308 @@
+//===--- undojournal.cc -------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#include "undojournal.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "system.h"
+
+namespace jig {
+namespace {
+
+constexpr char MAGIC[8] = {'j', 'i', 'g', 'u', 'n', 'd', 'o', '4'};
+
+constexpr char EDITS_EXTENSION[] = ".edits";
+constexpr char TEXT_EXTENSION[] = ".text";
+
+static_assert(sizeof(UndoJournal::Record) == 9 * sizeof(std::uint64_t),
+              "UndoJournal::Record has padding");
+
+bool writeAll(int fd, const void *data, std::size_t size, off_t offset) {
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t n = pwrite(fd, p, size, offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+bool readAll(int fd, void *data, std::size_t size, off_t offset) {
+  char *p = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t n = pread(fd, p, size, offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if (n == 0)
+      return false;
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+std::uint64_t getFileSize(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    return 0;
+  return static_cast<std::uint64_t>(st.st_size);
+}
+
+const void *mapFile(int fd, std::size_t size) {
+  if (size == 0)
+    return nullptr;
+  void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+    return nullptr;
+  return data;
+}
+
+} // namespace
+
+UndoJournal::UndoJournal(const Path &filePath) {
+  std::string base =
+    (System::getUndoDirectory() + System::getStateName(filePath)).getString();
+  m_EditsPath = base + EDITS_EXTENSION;
+  m_TextPath = base + TEXT_EXTENSION;
+  initHeader(m_Header);
+}
+
+UndoJournal::~UndoJournal() {
+  unmap();
+  if (m_EditsFd != -1)
+    close(m_EditsFd);
+  if (m_TextFd != -1)
+    close(m_TextFd);
+}
+
+void UndoJournal::initHeader(Header &header) {
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+}
+
+bool UndoJournal::open() {
+  if (!openFiles(O_RDWR))
+    return false;
+  if (!readAll(m_EditsFd, &m_Header, sizeof(m_Header), 0) ||
+      std::memcmp(m_Header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    Logger::warn("ignoring undo journal `%s' -- bad header",
+                 m_EditsPath.c_str());
+    return false;
+  }
+  m_EditsEnd = sizeof(Header) + m_Header.editCount * sizeof(Record);
+  m_TextEnd = m_Header.textLength;
+  if (m_Header.current > m_Header.editCount ||
+      getFileSize(m_EditsFd) < m_EditsEnd ||
+      getFileSize(m_TextFd) < m_TextEnd) {
+    Logger::warn("ignoring undo journal `%s' -- it was cut short",
+                 m_EditsPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool UndoJournal::map() {
+  // The Records are mapped along with the Header in front of them.
+  m_EditsMapSize = m_EditsEnd;
+  const void *edits = mapFile(m_EditsFd, m_EditsMapSize);
+  m_TextMapSize = m_TextEnd;
+  m_Text = static_cast<const char *>(mapFile(m_TextFd, m_TextMapSize));
+  if (!edits || (m_TextMapSize > 0 && !m_Text)) {
+    Logger::warn("failed to map undo journal `%s' -- %s", m_EditsPath.c_str(),
+                 std::strerror(errno));
+    if (edits)
+      munmap(const_cast<void *>(edits), m_EditsMapSize);
+    m_Text = nullptr;
+    unmap();
+    return false;
+  }
+  m_Records = static_cast<const char *>(edits) + sizeof(Header);
+  return true;
+}
+
+void UndoJournal::readRecord(std::size_t index, Record &record) const {
+  std::lock_guard<std::mutex> lock{m_Mutex};
+  std::memcpy(&record, m_Records + index * sizeof(Record), sizeof(record));
+}
+
+bool UndoJournal::write(const Checkpoint &checkpoint) {
+  return beginCheckpoint(checkpoint.keepCount) &&
+         updateRedoChildren(checkpoint.redoChildren) &&
+         append(checkpoint.records, checkpoint.text) &&
+         commitCheckpoint(checkpoint.header);
+}
+
+UndoJournal::Record UndoJournal::toRecord(const Edit &edit) {
+  Record record{};
+  record.pos = edit.pos;
+  record.insertedLength = edit.insertedLength;
+  record.erasedLength = edit.erasedLength;
+  record.textOffset = edit.textOffset;
+  record.parent = edit.parent;
+  record.redoChild = edit.redoChild;
+  record.depth = edit.depth;
+  record.time = edit.time;
+  record.type = static_cast<std::uint8_t>(edit.type);
+  record.joined = edit.joined;
+  return record;
+}
+
+Edit UndoJournal::toEdit(const Record &record) {
+  Edit edit{};
+  edit.pos = record.pos;
+  edit.insertedLength = record.insertedLength;
+  edit.erasedLength = record.erasedLength;
+  edit.textOffset = record.textOffset;
+  edit.type = static_cast<Edit::Type>(record.type);
+  edit.joined = record.joined != 0;
+  edit.parent = record.parent;
+  edit.redoChild = record.redoChild;
+  edit.depth = record.depth;
+  edit.time = record.time;
+  return edit;
+}
+
+// Throws away everything after the first "keepCount" Records, so the rest can
+// be appended. Anything already mapped in is always kept.
+bool UndoJournal::beginCheckpoint(std::uint64_t keepCount) {
+  if (m_EditsFd == -1 && !openFiles(O_RDWR | O_CREAT))
+    return false;
+
+  // Edits are stored in order, so the text of the last one kept ends where
+  // the text of everything after it begins.
+  std::uint64_t keepText = 0;
+  if (keepCount > 0) {
+    Record last;
+    if (!readAll(m_EditsFd, &last, sizeof(last),
+                 sizeof(Header) + (keepCount - 1) * sizeof(Record))) {
+      Logger::warn("failed to read undo journal `%s'", m_EditsPath.c_str());
+      return false;
+    }
+    keepText = last.textOffset + last.insertedLength + last.erasedLength;
+  }
+
+  // Until the new Header is written, what's in the files won't match the old
+  // one, so make sure that one can't be read back.
+  Header invalid;
+  std::memset(&invalid, 0, sizeof(invalid));
+  if (!writeAll(m_EditsFd, &invalid, sizeof(invalid), 0) ||
+      fdatasync(m_EditsFd) != 0) {
+    Logger::warn("failed to write undo journal `%s' -- %s",
+                 m_EditsPath.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  m_EditsEnd = sizeof(Header) + keepCount * sizeof(Record);
+  m_TextEnd = keepText;
+  if (ftruncate(m_EditsFd, m_EditsEnd) != 0 ||
+      ftruncate(m_TextFd, m_TextEnd) != 0) {
+    Logger::warn("failed to truncate undo journal `%s' -- %s",
+                 m_EditsPath.c_str(), std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool UndoJournal::updateRedoChildren(
+  const std::vector<std::pair<std::uint64_t, std::uint64_t>> &redoChildren) {
+  std::lock_guard<std::mutex> lock{m_Mutex};
+  for (const auto &change : redoChildren) {
+    off_t offset = sizeof(Header) + (change.first - 1) * sizeof(Record) +
+                   offsetof(Record, redoChild);
+    if (!writeAll(m_EditsFd, &change.second, sizeof(change.second), offset)) {
+      Logger::warn("failed to write undo journal `%s' -- %s",
+                   m_EditsPath.c_str(), std::strerror(errno));
+      return false;
+    }
+  }
+  return true;
+}
+
+bool UndoJournal::append(const std::vector<Record> &records,
+                         const std::string &text) {
+  std::size_t size = records.size() * sizeof(Record);
+  if (!writeAll(m_EditsFd, records.data(), size, m_EditsEnd) ||
+      !writeAll(m_TextFd, text.data(), text.size(), m_TextEnd)) {
+    Logger::warn("failed to write undo journal `%s' -- %s",
+                 m_EditsPath.c_str(), std::strerror(errno));
+    return false;
+  }
+  m_EditsEnd += size;
+  m_TextEnd += text.size();
+  return true;
+}
+
+bool UndoJournal::commitCheckpoint(const Header &header) {
+  // Everything the Header refers to has to be on disk before the Header is.
+  if (fdatasync(m_TextFd) != 0 || fdatasync(m_EditsFd) != 0 ||
+      !writeAll(m_EditsFd, &header, sizeof(header), 0) ||
+      fdatasync(m_EditsFd) != 0) {
+    Logger::warn("failed to write undo journal `%s' -- %s",
+                 m_EditsPath.c_str(), std::strerror(errno));
+    return false;
+  }
+  m_Header = header;
+  return true;
+}
+
+bool UndoJournal::openFiles(int flags) {
+  m_EditsFd = ::open(m_EditsPath.c_str(), flags | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (m_EditsFd == -1) {
+    if (errno != ENOENT)
+      Logger::warn("failed to open undo journal `%s' -- %s",
+                   m_EditsPath.c_str(), std::strerror(errno));
+    return false;
+  }
+  m_TextFd = ::open(m_TextPath.c_str(), flags | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (m_TextFd == -1) {
+    Logger::warn("failed to open undo journal `%s' -- %s", m_TextPath.c_str(),
+                 std::strerror(errno));
+    close(m_EditsFd);
+    m_EditsFd = -1;
+    return false;
+  }
+  return true;
+}
+
+void UndoJournal::unmap() {
+  if (m_Records)
+    munmap(const_cast<char *>(m_Records - sizeof(Header)), m_EditsMapSize);
+  if (m_Text)
+    munmap(const_cast<char *>(m_Text), m_TextMapSize);
+  m_Records = nullptr;
+  m_Text = nullptr;
+}
+
+} // namespace jig
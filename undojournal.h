@@ -0,0 +1,150 @@
+//===--- undojournal.h --------------------------------------------------===//
+// Copyright (c) 2017 Nathan Forbes
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===--------------------------------------------------------------------===//
+
+#ifndef __JIG_UNDOJOURNAL_H__
+#define __JIG_UNDOJOURNAL_H__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "edit.h"
+#include "path.h"
+
+namespace jig {
+
+// The undo history of a file, kept on disk so that it can be picked up again
+// the next time the file is opened. A journal is a pair of files in the undo
+// directory, named after a hash of the file's real path. One holds a Header
+// followed by a Record for every Edit, and the other holds their text, so
+// both can be mapped in and read from as they are.
+//
+// Edits are only ever added to the history, so a checkpoint just appends
+// what's new since the one before it, and writes the Header last. A journal
+// that was cut short by a crash doesn't add up to what its Header says and is
+// ignored.
+class UndoJournal {
+public:
+  struct Header {
+    char magic[8];
+    // The text the file held when the journal was written.
+    std::uint64_t contentLength;
+    std::uint64_t contentHash;
+    std::uint64_t editCount;
+    // The Edit that leads to that text, counting from 1, or 0 for none, and
+    // where redo goes from the original text.
+    std::uint64_t current;
+    std::uint64_t rootRedoChild;
+    std::uint64_t textLength;
+  };
+
+  // How an Edit is stored. Every field has a fixed size and the padding is
+  // spelled out, so nothing but the Edit itself ends up on disk.
+  struct Record {
+    std::uint64_t pos;
+    std::uint64_t insertedLength;
+    std::uint64_t erasedLength;
+    std::uint64_t textOffset;
+    std::uint64_t parent;
+    std::uint64_t redoChild;
+    std::uint64_t depth;
+    std::int64_t time;
+    std::uint8_t type;
+    std::uint8_t joined;
+    std::uint8_t unused[6];
+  };
+
+  // Everything a checkpoint writes, copied out of an EditHistory so that it
+  // can be written by another thread while editing carries on.
+  struct Checkpoint {
+    std::shared_ptr<UndoJournal> journal;
+    // The Records after the first "keepCount" are replaced with "records".
+    std::uint64_t keepCount;
+    std::vector<Record> records;
+    std::string text;
+    // Edits that are kept but whose redoChild has changed since, as pairs of
+    // the edit and its new redoChild.
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> redoChildren;
+    // The contentLength and contentHash are filled in once the file has been
+    // saved.
+    Header header;
+  };
+
+  UndoJournal(const Path &filePath);
+  ~UndoJournal();
+
+  UndoJournal(const UndoJournal &) = delete;
+  UndoJournal &operator=(const UndoJournal &) = delete;
+
+  const std::string &getPath() const { return m_EditsPath; }
+
+  // Reads the Header of an existing journal. Returns false if there isn't one
+  // or it can't be trusted.
+  bool open();
+  const Header &getHeader() const { return m_Header; }
+
+  // Maps the Records and text in. Each Record's textOffset is into getText().
+  // Only the Records that were there when it was mapped can be read, and
+  // they can be read while a checkpoint is being written.
+  bool map();
+  void readRecord(std::size_t index, Record &record) const;
+  const char *getText() const { return m_Text; }
+
+  // Can be called from any thread, as long as only one checkpoint is written
+  // at a time.
+  bool write(const Checkpoint &checkpoint);
+
+  static void initHeader(Header &header);
+
+  static Record toRecord(const Edit &edit);
+  static Edit toEdit(const Record &record);
+
+private:
+  bool beginCheckpoint(std::uint64_t keepCount);
+  bool updateRedoChildren(
+    const std::vector<std::pair<std::uint64_t, std::uint64_t>> &redoChildren);
+  bool append(const std::vector<Record> &records, const std::string &text);
+  bool commitCheckpoint(const Header &header);
+
+  bool openFiles(int flags);
+  void unmap();
+
+  std::string m_EditsPath;
+  std::string m_TextPath;
+  int m_EditsFd = -1;
+  int m_TextFd = -1;
+  Header m_Header;
+
+  const char *m_Records = nullptr;
+  const char *m_Text = nullptr;
+  std::size_t m_EditsMapSize = 0;
+  std::size_t m_TextMapSize = 0;
+
+  // A checkpoint writes redoChild in place in Records that may be mapped in,
+  // so they aren't read while it does.
+  mutable std::mutex m_Mutex;
+
+  // Where the next append() goes in each file.
+  std::uint64_t m_EditsEnd = 0;
+  std::uint64_t m_TextEnd = 0;
+};
+
+} // namespace jig
+
+#endif // __JIG_UNDOJOURNAL_H__
@@ -18,6 +18,7 @@
 
 #include <assert.h>
 
+#include "app.h"
 #include "logger.h"
 
 namespace jig {
@@ -57,11 +58,17 @@ int View::getKeypress() {
   return m_Window->getKeypress();
 }
 
+void View::setInputTimeout(int millis) {
+  assert(m_Window != nullptr && "This View's Window object is uninitialized");
+  m_Window->setInputTimeout(millis);
+}
+
 void View::initWindow(const char *name, int height, int width, int startY,
                       int startX) {
   Logger::info("Creating view \"%s\": height=%d width=%d y=%d x=%d", name,
                height, width, startY, startX);
-  m_Window = std::make_unique<Window>(height, width, startY, startX);
+  m_Window = std::make_unique<Window>(App::getInstance().getUI().getScreen(),
+                                      height, width, startY, startX);
 }
 
 void View::writeToWindow() {
@@ -39,6 +39,7 @@ public:
   int getStartX() const;
 
   virtual int getKeypress();
+  void setInputTimeout(int millis);
 
 protected:
   void initWindow(const char *name, int height, int width, int startY,
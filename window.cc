@@ -16,7 +16,11 @@
 
 #include "window.h"
 
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include <ncurses.h>
 
@@ -35,133 +39,130 @@ const int Window::Attr::PROTECT = A_PROTECT;
 const int Window::Attr::INVISIBLE = A_INVIS;
 // const int Window::Attr::ITALIC = A_ITALIC;
 
-Window::Window(int h, int w, int y, int x)
-    : m_Height{h},
-      m_Width{w},
-      m_StartY{y},
-      m_StartX{x},
-      m_BackgroundColor{Color::DEFAULT, Color::DEFAULT} {
-  WINDOW **p = ((WINDOW **)&m_WinPtr);
-  *p = newwin(m_Height, m_Width, m_StartY, m_StartX);
-  if (!*p) {
-    Logger::fatal("failed to create new Ncurses window");
-    std::exit(EXIT_FAILURE);
-  }
-  wbkgd(*p, m_BackgroundColor.getPairAttribute());
-}
+Window::Window(Screen &screen, int h, int w, int y, int x)
+    : Window{screen, h, w, y, x, Color{Color::DEFAULT, Color::DEFAULT}} {}
 
-Window::Window(int h, int w, int y, int x, const Color &backgroundColor)
-    : m_Height{h},
+Window::Window(Screen &screen, int h, int w, int y, int x,
+               const Color &backgroundColor)
+    : m_Surface{screen.createSurface(h, w, y, x)},
+      m_Height{h},
       m_Width{w},
       m_StartY{y},
       m_StartX{x},
       m_BackgroundColor{backgroundColor} {
-  WINDOW **p = ((WINDOW **)&m_WinPtr);
-  *p = newwin(m_Height, m_Width, m_StartY, m_StartX);
-  if (!*p) {
-    Logger::fatal("failed to create new Ncurses window");
+  if (!m_Surface) {
+    Logger::fatal("failed to create new window");
     std::exit(EXIT_FAILURE);
   }
-  wbkgd(*p, m_BackgroundColor.getPairAttribute());
-}
-
-Window::~Window() {
-  delwin((WINDOW *)m_WinPtr);
+  m_Surface->setBackground(m_BackgroundColor.getPairAttribute());
 }
 
 void Window::moveCursor(int y, int x) {
-  wmove((WINDOW *)m_WinPtr, y, x);
+  m_Surface->moveCursor(y, x);
 }
 
 void Window::enableKeypad() {
-  keypad((WINDOW *)m_WinPtr, true);
+  m_Keypad = true;
+  m_Surface->setKeypad(m_Keypad);
 }
 
 void Window::disableKeypad() {
-  keypad((WINDOW *)m_WinPtr, false);
+  m_Keypad = false;
+  m_Surface->setKeypad(m_Keypad);
 }
 
 void Window::enableAttrs(int attrs) {
-  wattron((WINDOW *)m_WinPtr, attrs);
   m_Attrs |= attrs;
+  m_Surface->setAttrs(m_Attrs);
 }
 
 void Window::disableAttrs(int attrs) {
-  wattroff((WINDOW *)m_WinPtr, attrs);
   m_Attrs &= ~(attrs);
+  m_Surface->setAttrs(m_Attrs);
 }
 
 void Window::disableAllAttrs() {
-  wattroff((WINDOW *)m_WinPtr, m_Attrs);
   m_Attrs = 0;
+  m_Surface->setAttrs(m_Attrs);
 }
 
 void Window::setBackgroundColor(const Color &color) {
   m_BackgroundColor = color;
-  wbkgd((WINDOW *)m_WinPtr, m_BackgroundColor.getPairAttribute());
+  m_Surface->setBackground(m_BackgroundColor.getPairAttribute());
 }
 
 void Window::put(int y, int x, char ch) {
-  mvwaddch((WINDOW *)m_WinPtr, y, x, ch);
+  m_Surface->put(y, x, ch);
 }
 
 void Window::put(int y, int x, const char *str) {
-  mvwaddstr((WINDOW *)m_WinPtr, y, x, str);
+  m_Surface->put(y, x, str, std::strlen(str));
 }
 
 void Window::put(int y, int x, const char *str, std::size_t count) {
-  mvwaddnstr((WINDOW *)m_WinPtr, y, x, str, count);
+  m_Surface->put(y, x, str, count);
 }
 
 void Window::put(int y, int x, const std::string &str) {
-  mvwaddnstr((WINDOW *)m_WinPtr, y, x, str.c_str(), str.size());
+  m_Surface->put(y, x, str.data(), str.size());
 }
 
 void Window::put(int y, int x, const std::string &str, std::size_t count) {
-  mvwaddnstr((WINDOW *)m_WinPtr, y, x, str.c_str(), count);
+  m_Surface->put(y, x, str.data(), count);
 }
 
 void Window::putf(int y, int x, const char *fmt, ...) {
+  char buf[256];
   va_list args;
   va_start(args, fmt);
-  wmove((WINDOW *)m_WinPtr, y, x);
-  vw_printw((WINDOW *)m_WinPtr, fmt, args);
+  int n = std::vsnprintf(buf, sizeof(buf), fmt, args);
   va_end(args);
+  if (n < 0)
+    return;
+  m_Surface->put(y, x, buf, std::min(static_cast<std::size_t>(n),
+                                     sizeof(buf) - 1));
 }
 
 int Window::getKeypress() {
-  return wgetch((WINDOW *)m_WinPtr);
+  return m_Surface->getKeypress();
+}
+
+void Window::setInputTimeout(int millis) {
+  m_Surface->setInputTimeout(millis);
 }
 
 void Window::clear() {
-  wclear((WINDOW *)m_WinPtr);
+  m_Surface->clear();
+}
+
+void Window::clearToEndOfLine(int y, int x) {
+  m_Surface->clearToEndOfLine(y, x);
 }
 
 void Window::move(int y, int x) {
-  if (mvwin((WINDOW *)m_WinPtr, y, x) != ERR) {
+  if (m_Surface->move(y, x)) {
     m_StartY = y;
     m_StartX = x;
   }
 }
 
 void Window::resize(int h, int w) {
-  WINDOW **p = ((WINDOW **)&m_WinPtr);
-  delwin(*p);
-  *p = newwin(h, w, m_StartY, m_StartX);
-  if (!*p) {
-    Logger::fatal("failed to resize Ncurses window");
+  if (!m_Surface->resize(h, w)) {
+    Logger::fatal("failed to resize window");
     std::exit(EXIT_FAILURE);
   }
-  wbkgd(*p, m_BackgroundColor.getPairAttribute());
+  m_Surface->setBackground(m_BackgroundColor.getPairAttribute());
   if (m_Attrs != 0)
-    wattron(*p, m_Attrs);
+    m_Surface->setAttrs(m_Attrs);
+  if (m_Keypad)
+    m_Surface->setKeypad(m_Keypad);
   m_Height = h;
   m_Width = w;
-  wrefresh(*p);
+  m_Surface->refresh();
 }
 
 void Window::refresh() {
-  wrefresh((WINDOW *)m_WinPtr);
+  m_Surface->refresh();
 }
 
 } // namespace jig
@@ -17,9 +17,11 @@
 #ifndef __JIG_WINDOW_H__
 #define __JIG_WINDOW_H__
 
+#include <memory>
 #include <string>
 
 #include "color.h"
+#include "screen.h"
 
 namespace jig {
 
@@ -39,10 +41,9 @@ public:
     // static const int ITALIC;
   };
 
-  Window() = default;
-  Window(int h, int w, int y, int x);
-  Window(int h, int w, int y, int x, const Color &backgroundColor);
-  ~Window();
+  Window(Screen &screen, int h, int w, int y, int x);
+  Window(Screen &screen, int h, int w, int y, int x,
+         const Color &backgroundColor);
 
   int getHeight() const { return m_Height; }
   int getWidth() const { return m_Width; }
@@ -69,19 +70,22 @@ public:
   void putf(int y, int x, const char *fmt, ...);
 
   int getKeypress();
+  void setInputTimeout(int millis);
 
   void clear();
+  void clearToEndOfLine(int y, int x);
   void move(int y, int x);
   void resize(int h, int w);
   void refresh();
 
 private:
-  void *m_WinPtr = nullptr;
+  std::unique_ptr<Screen::Surface> m_Surface;
   int m_Height = 0;
   int m_Width = 0;
   int m_StartY = 0;
   int m_StartX = 0;
   int m_Attrs = 0;
+  bool m_Keypad = false;
   Color m_BackgroundColor;
 };
 